@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+#include <Eigen/SparseCore>
+
+#include "solver.h"
+#include "util.h"
+
+#define AUTOTUNE_CACHE_FILE "spic_autotune.cache" // Decisions kept next to the circuit file
+#define AUTOTUNE_TRIAL_SOLVES 3 // Timed solves of every candidate after its analyze()
+#define AUTOTUNE_MAX_DENSE 2000 // Largest system for which dense candidates are tried
+
+namespace spic {
+	/* Picks the solver options of a deck by timing short trials of the candidate methods */
+	class Autotuner {
+		public:
+		options_t &options;
+		Logger &logger;
+
+		Autotuner(options_t &options, Logger &logger) : options(options), logger(logger) {}
+
+		void tune(std::filesystem::path cache_file);
+
+		private:
+		typedef struct candidate {
+			options_t options;
+			double secs;     // Estimated time of all the solves of the deck
+			double residual; // Relative residual ||Ax - b|| / ||b|| of the trial
+		} candidate_t;
+
+		uint64_t get_signature(const Eigen::SparseMatrix<double> &A);
+		bool is_symmetric(const Eigen::SparseMatrix<double> &A);
+		bool is_diagonally_dominant(const Eigen::SparseMatrix<double> &A);
+		int expected_solves();
+
+		std::vector<candidate_t> get_candidates(bool spd, bool dense);
+		void trial(candidate_t &candidate, MNASystem *system, MNASparseSystem &sparse_system,
+					const Eigen::SparseMatrix<double> &A, const Eigen::VectorXd &b);
+		std::string get_method_name(const options_t &trial_options);
+
+		bool load_decision(std::filesystem::path cache_file, uint64_t signature);
+		void store_decision(std::filesystem::path cache_file, uint64_t signature);
+	};
+}
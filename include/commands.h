@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <memory>
 
 #include <Eigen/Dense>
 
@@ -11,6 +12,9 @@
 #include "netlist.h"
 #include "dc_sweeps.h"
 #include "transient.h"
+#include "whatif.h"
+#include "scenario.h"
+#include "factorization_cache.h"
 
 namespace spic {
 	class Commands {
@@ -21,8 +25,12 @@ namespace spic {
 		std::filesystem::path dc_sweeps_dir;
 		std::vector<TransientAnalysis> transient_list;
 		std::filesystem::path transient_dir;
+		std::vector<WhatIf> whatifs;
+		std::filesystem::path whatif_dir;
+		std::vector<Scenario> scenarios; // Stimulus sets advanced together by every Transient Analysis
 		std::vector<std::string> print_nodes;
 		std::vector<std::string> plot_nodes;
+		std::unique_ptr<FactorizationCache> factorization_cache; // Kept by the transients for the DC analysis
 
 
 		Commands() { options = {0}; }
@@ -31,6 +39,10 @@ namespace spic {
 		void perform_dc_sweeps(Solver *solver, Logger &logger);
 		void perform_transients(Solver &solver, MNASystem &mna_system, Logger &logger);
 		void perform_transients(Solver &solver, MNASparseSystem &mna_sp_system, Logger &logger);
+		void perform_whatifs(Solver *solver, Logger &logger);
+
+		private:
+		int transient_jobs(long analysis_bytes, Logger &logger);
 	};
 }
 std::ostream& operator<<(std::ostream &out, const spic::Commands &commands);
@@ -6,6 +6,8 @@
 
 #include "solver.h"
 
+#define DC_SWEEP_BLOCK_SIZE 16 // Sweep points solved together in a block of right-hand sides
+
 namespace spic {
 	class DCSweep {
 		public:
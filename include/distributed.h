@@ -0,0 +1,91 @@
+#pragma once
+
+#ifdef SPIC_MPI
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include <mpi.h>
+
+#include <Eigen/SparseCore>
+
+#include "solver.h"
+#include "netlist.h"
+#include "util.h"
+
+#define DISTRIBUTE_CHUNK 65536 // Elements rank 0 sends to a rank in one message while it reads the netlist
+
+namespace spic {
+	/* Element of the netlist sent to the ranks whose rows it stamps, id is the index of
+	 * the branch current of a voltage source or inductor
+	 */
+	typedef struct {
+		int id;
+		node_id_t node_positive;
+		node_id_t node_negative;
+		double value;
+	} stamp_element_t;
+
+	/* Distributed memory Jacobi preconditioned CG for the DC operating point.
+	 * Rank 0 parses the circuit, spooling the resistors to a temporary file, and sends every
+	 * rank the elements that touch its contiguous block of rows of the MNA system. A rank
+	 * stamps and owns only those rows, and only exchanges the entries of the search direction
+	 * its rows reference (halo).
+	 */
+	class DistributedSolver {
+		public:
+		int rank;
+		int size;
+		int n;         // Dimension of the whole MNA system
+		int total_nodes;
+		int row_begin; // Owned rows are [row_begin, row_end)
+		int row_end;
+
+		options_t &options;
+		Logger &logger;
+
+		Eigen::SparseMatrix<double, Eigen::RowMajor> A; // Owned rows, columns are [owned | ghosts]
+		Eigen::VectorXd b; // Owned entries of b
+		Eigen::VectorXd x; // Owned entries of x
+		Eigen::VectorXd inv_precond;
+
+		int iterations;
+		double error;
+
+		struct {
+			double secs_in_assembly;
+			double secs_in_solve;
+			int halo_exchanges;
+		} perf_counter;
+
+		DistributedSolver(Netlist &netlist, int total_nodes, options_t &options, Logger &logger);
+		~DistributedSolver() {}
+
+		void solve();
+		void dump_print_nodes(std::vector<std::string> &prints, std::filesystem::path filename);
+		void dump_perf_counters(std::filesystem::path filename, double g_time);
+
+		private:
+		std::vector<int> row_starts; // First row of every rank, row_starts[size] = n
+		std::vector<int> ghosts;     // Global ids of the columns owned by other ranks, sorted
+		std::vector<int> send_idx;   // Owned entries every other rank needs, grouped by rank
+		std::vector<int> send_counts, send_displs;
+		std::vector<int> recv_counts, recv_displs;
+		std::vector<double> send_buffer;
+
+		int owner(int row);
+		void distribute_elements(Netlist &netlist, std::vector<stamp_element_t> &resistors,
+								 std::vector<stamp_element_t> &current_sources,
+								 std::vector<stamp_element_t> &branches);
+		void stamp_rows(const std::vector<stamp_element_t> &resistors,
+						const std::vector<stamp_element_t> &current_sources,
+						const std::vector<stamp_element_t> &branches,
+						std::vector<Eigen::Triplet<double>> &triplets);
+		void setup_halo(std::vector<Eigen::Triplet<double>> &triplets);
+		void halo_exchange(Eigen::VectorXd &p_ext);
+		double dot(const Eigen::VectorXd &u, const Eigen::VectorXd &v);
+	};
+}
+
+#endif
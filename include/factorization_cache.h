@@ -0,0 +1,51 @@
+#pragma once
+
+#include <list>
+#include <memory>
+
+#include <Eigen/Dense>
+#include <Eigen/SparseCore>
+
+#include "util.h"
+#include "solver.h"
+#include "system.h"
+#include "sparse_system.h"
+
+namespace spic {
+	/* Least recently used cache of the solvers of A = G + alpha * C, keyed by alpha. The integration
+	 * method only determines alpha, so the steps of every method and analysis that give the same
+	 * matrix share a factorization. Every cached solver works on its own copy of A, except for
+	 * alpha = 0 which is the DC solver on the MNA system itself. The least recently used solvers
+	 * are dropped when the estimated size of the cached ones exceeds the budget. A solver returned
+	 * by get() stays valid until the next call of get().
+	 */
+	class FactorizationCache {
+		public:
+		FactorizationCache(Solver &dc_solver, std::shared_ptr<Eigen::SparseMatrix<double>> G,
+						   std::shared_ptr<Eigen::SparseMatrix<double>> C, long budget_bytes);
+		FactorizationCache(Solver &dc_solver, std::shared_ptr<Eigen::MatrixXd> G,
+						   std::shared_ptr<Eigen::MatrixXd> C, long budget_bytes);
+		~FactorizationCache();
+
+		Solver &get(double alpha);
+
+		private:
+		typedef struct entry {
+			double alpha;
+			long bytes; // Estimated size of A and its factorization (or preconditioner)
+			std::unique_ptr<System> system;
+			std::unique_ptr<SparseSystem> sparse_system;
+			std::unique_ptr<Solver> solver;
+		} entry_t;
+
+		Solver &dc_solver;
+		bool dc_factored;
+		std::shared_ptr<Eigen::SparseMatrix<double>> sparse_G, sparse_C;
+		std::shared_ptr<Eigen::MatrixXd> G, C;
+		long budget_bytes;
+		long cached_bytes;
+		std::list<entry_t> entries; // Most recently used first
+
+		void evict(long bytes);
+	};
+}
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <vector>
+#include <cstdio>
 #include <cmath>
 #include <cassert>
 
@@ -143,9 +144,23 @@ namespace spic {
 			}
 		};
 
+	/* Resistor of a netlist that is spooled to a file instead of kept in memory */
+	typedef struct {
+		node_id_t node_positive;
+		node_id_t node_negative;
+		float value;
+	} spooled_resistor_t;
+
 	/* Netlist class contains a list of pointers to each element type */
 	class Netlist {
 		public:
+		// If set, the resistors are written to this file as they are parsed instead of being kept, and
+		// the capacitors are dropped, since the MPI mode only solves the DC operating point and reads
+		// the resistors once. Their names are not kept, so duplicate resistor names are not detected.
+		std::FILE *spool = nullptr;
+		long spooled_resistors = 0;
+
+
 		spic::ElementList<VoltageSource> voltage_sources;
 		spic::ElementList<CurrentSource> current_sources;
 		spic::ElementList<Resistor>      resistors;
@@ -163,6 +178,8 @@ namespace spic {
 		bool add_diode(Diode *d);
 		bool add_mos(MOS *m);
 		bool add_bjt(BJT *q);
+
+		bool is_linear();
 	};
 
 }
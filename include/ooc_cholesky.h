@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <Eigen/SparseCore>
+#include <Eigen/OrderingMethods>
+
+#include "util.h"
+
+#define OOC_PANELS_IN_BUDGET 4 // The panel kept in memory while it is filled is this fraction of the budget
+
+namespace spic {
+	/* Left-looking sparse Cholesky that spills the completed columns of L to a scratch file.
+	 * The columns are appended to an in-memory panel, which is written with one sequential
+	 * write when it is full and read back through a read-only memory map. The mapped panels
+	 * are clean file-backed pages, so the kernel can evict them when memory runs low.
+	 */
+	class OutOfCoreCholesky {
+		public:
+		OutOfCoreCholesky(const Eigen::SparseMatrix<double> &A, long budget_bytes, Logger &logger);
+		~OutOfCoreCholesky();
+
+		bool compute();
+		Eigen::MatrixXd solve(const Eigen::MatrixXd &B);
+
+		int panels() { return panel_maps.size(); }
+		long bytes_spilled() { return file_size; }
+
+		private:
+		typedef struct entry {
+			int row;
+			double value;
+		} entry_t;
+
+		int n;
+		long panel_bytes;
+		Logger &logger;
+
+		Eigen::SparseMatrix<double> C; // P A P^T
+		Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> P, Pinv;
+		std::vector<int> parent; // Elimination tree of C
+
+		// Column j of L is col_len[j] entries, the diagonal first, in panel col_panel[j] at col_offset[j]
+		std::vector<int> col_panel;
+		std::vector<long> col_offset;
+		std::vector<int> col_len;
+
+		std::vector<entry_t> buffer; // Panel being filled
+		std::vector<entry_t*> panel_maps;
+		std::vector<long> panel_sizes; // Mapped bytes of every panel
+		int fd;
+		long file_size;
+
+		void etree();
+		int ereach(int k, std::vector<int> &s, std::vector<int> &w);
+		const entry_t *column(int j);
+		bool flush();
+	};
+}
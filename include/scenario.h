@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+
+#include "netlist.h"
+
+namespace spic {
+	/* A stimulus set of the transient analyses, read from a file of V and I lines that give new
+	 * values and waveforms to sources of the netlist. The scenarios share the MNA matrices, thus
+	 * a source keeps its nodes and the sources that a scenario does not give keep their own stimulus.
+	 */
+	class Scenario {
+		public:
+		std::filesystem::path file;
+		std::unordered_map<int, VoltageSource> voltage_sources; // Replaced sources, by their id in the netlist
+		std::unordered_map<int, CurrentSource> current_sources;
+
+		Scenario(std::filesystem::path file) : file(file) {}
+
+		bool change_voltage_source(VoltageSource &v);
+		bool change_current_source(CurrentSource &i);
+
+		Source &voltage_source(int id);
+		Source &current_source(int id);
+	};
+}
+
+std::ostream& operator<<(std::ostream &out, const spic::Scenario &scenario);
+std::ostream& operator<<(std::ostream &out, const std::vector<spic::Scenario> &scenarios);
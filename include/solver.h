@@ -2,35 +2,66 @@
 
 #include <iostream>
 #include <filesystem>
+#include <memory>
+#include <functional>
 
 #include <Eigen/LU>
+#include <Eigen/QR>
 #include <Eigen/Cholesky>
+#include <Eigen/Eigenvalues>
 #include <Eigen/IterativeLinearSolvers>
 #include <Eigen/SparseLU>
 #include <Eigen/SparseCholesky>
+#include <unsupported/Eigen/IterativeSolvers>
 
 #include "system.h"
 #include "sparse_system.h"
 #include "util.h"
+#include "ooc_cholesky.h"
 
 #define EPS 1e-23
+#define EPS_BLOCK 1e-12 // Reciprocal condition number below which a Krylov block is considered dependent
+#define MIXED_REFINE_TOL 1e-12 // Relative residual targeted by iterative refinement
+#define MIXED_MAX_REFINE 20 // Refinement steps before falling back to double precision
+#define GMRES_DEFAULT_RESTART 30 // Krylov subspace dimension of GMRES when RESTART is not given
+#define DEFLATION_HARVEST_SOLVES 8 // Solves after each compute() whose search directions refine the deflation space
+#define SCHUR_SEPARATOR_SCALE 32 // Largest separator, in multiples of sqrt(n), before falling back to a single factorization
+#define SCHUR_MEMORY_FRACTION 0.25 // Fraction of the available memory the dense Schur complement may use
+#define SCHUR_RHS_BLOCK 64 // Separator columns eliminated together from a subdomain
+#define SCALING_MAX_PASSES 10 // Passes of the iterative (Ruiz) equilibration of A
+#define SCALING_TOL 1e-2 // Largest deviation of the row and column max norms from 1 after equilibration
 
 namespace spic {
 	typedef enum transient_method transient_method_t;
-	enum transient_method : unsigned int { BE, TR };
+	enum transient_method : unsigned int { BE, TR, GEAR, EXP };
 	
 	typedef struct options {
 		bool custom; // Enable usage of custom implementations
 		bool spd; // If iter=false: Enable cholesky decomp, else: Enable conjugate gradient
 		bool iter; // Enables iterative methods (conjugate gradient & biconjugate gradient)
 		bool sparse; // Enables the usage of sparse matrices
+		bool mixed; // Enables single precision factorization with iterative refinement for direct methods
+		bool gmres; // If iter=true: Use restarted GMRES instead of CG/BiCG
+		int restart; // Restart length of GMRES (0 for GMRES_DEFAULT_RESTART)
+		bool bicgstab; // If iter=true: Use BiCGSTAB instead of CG/BiCG
+		bool autotune; // Replace sparse/iter/spd/custom/gmres/bicgstab with the fastest method of timed trials
+		bool scale; // Equilibrate the rows and columns of A before decomposing or computing
+		int deflation; // Number of approximate eigenvectors recycled across custom CG solves (0 disables it)
+		int predictor; // Order of the polynomial extrapolating the initial guess of iterative transient solves
+		int domains; // Subdomains of the Schur complement solver for sparse direct methods (0 disables it)
+		int ooc; // Memory budget in MB of the out-of-core sparse Cholesky (0 keeps the factor in memory)
 		double itol; // The convergence threshold for iterative methods
+		double lte_tol; // Tolerance of the local truncation error of adaptive transient steps (0 keeps the fixed step)
+		int parareal; // Time slices of the Parareal transient engine (0 runs the steps sequentially)
+		int tran_jobs; // Transient analyses run concurrently, capped by the available memory (0 runs them one by one)
+		int fact_cache; // Memory budget in MB of the cache of factorizations of G + alpha * C (0 disables it)
 		transient_method_t transient_method; // Method for calculatg derivative in Transient Analysis
 	} options_t;
 
 	class Solver {
 		public:
-		typedef enum {LU, CHOLESKY, CG, BiCG} method_t;
+		typedef enum {LU, CHOLESKY, CG, BiCG, GMRES, BiCGSTAB} method_t;
+		static constexpr const char *method_names[] = {"LU", "Cholesky", "CG", "BiCG", "GMRES", "BiCGSTAB"};
 
 		/* General variables */
 		method_t method;
@@ -47,10 +78,43 @@ namespace spic {
 		Logger &logger;
 
 		// Algorithm specific variables
-		union {
-			Eigen::VectorXi *perm;
-			Eigen::VectorXd *inv_precond;
-		};
+		std::unique_ptr<Eigen::VectorXi> perm;
+		std::unique_ptr<Eigen::VectorXd> inv_precond;
+
+		// Row-major copy of a sparse A for the custom iterative methods
+		Eigen::SparseMatrix<double, Eigen::RowMajor> csr_A;
+
+		// Rows of A (and entries of the vectors) of every thread in the custom iterative methods
+		std::vector<int> row_partition;
+
+		// Deflation space recycled across the solves of the custom CG
+		struct {
+			Eigen::MatrixXd W;  // Approximate eigenvectors of M^-1 A for the smallest eigenvalues
+			Eigen::MatrixXd AW; // A * W
+			Eigen::LLT<Eigen::MatrixXd> WtAW; // Cholesky factorization of W^T A W
+			int harvests; // Solves that have refined W since the last compute()
+		} deflation;
+
+		// Domain decomposition of the sparse direct methods into subdomain interiors and a separator
+		struct {
+			bool active; // The last decompose() factored the subdomains and the Schur complement
+			std::vector<std::vector<int>> interiors; // Unknowns of every subdomain
+			std::vector<int> separator; // Unknowns of the separator
+			std::vector<Eigen::SparseMatrix<double>> A_II; // Interior blocks
+			std::vector<Eigen::SparseMatrix<double>> A_IS; // Couplings of the interiors to the separator
+			std::vector<Eigen::SparseMatrix<double>> A_SI; // Couplings of the separator to the interiors
+			std::vector<std::unique_ptr<Eigen::SparseLU<Eigen::SparseMatrix<double>>>> lu;
+			std::vector<std::unique_ptr<Eigen::SimplicialLLT<Eigen::SparseMatrix<double>, Eigen::Lower, Eigen::COLAMDOrdering<int>>>> cholesky;
+			Eigen::PartialPivLU<Eigen::MatrixXd> S_lu; // S = A_SS - sum(A_SI A_II^-1 A_IS)
+			Eigen::LLT<Eigen::MatrixXd> S_cholesky;
+		} schur;
+
+		// Equilibration of A, the solver works on row * A * col with b scaled by row and x by col^-1
+		struct {
+			bool active; // The last analyze() scaled A in place
+			Eigen::VectorXd row;
+			Eigen::VectorXd col;
+		} scaling;
 
 		union {
 			// Direct
@@ -60,31 +124,56 @@ namespace spic {
 			struct {
 				int iterations;
 				double error;
+				double tolerance; // Threshold of the solves, ITOL after analyze() unless set_tolerance() changes it
 			};
 		};
 
-		union {
-			// LU
-			Eigen::PartialPivLU<Eigen::Ref<Eigen::MatrixXd>> *lu;
-			Eigen::SparseLU<Eigen::SparseMatrix<double>> *sparse_lu;
-			// Cholesky
-			Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>> *cholesky;
-			Eigen::SimplicialLLT<Eigen::SparseMatrix<double>, Eigen::Lower, Eigen::COLAMDOrdering<int>> *sparse_cholesky;
-			// CG
-			Eigen::ConjugateGradient<Eigen::MatrixXd, Eigen::Lower|Eigen::Upper> *cg;
-			Eigen::ConjugateGradient<Eigen::SparseMatrix<double>, Eigen::Lower|Eigen::Upper> *sparse_cg;
-			// BiCG
-			Eigen::BiCGSTAB<Eigen::MatrixXd> *bicg;
-			Eigen::BiCGSTAB<Eigen::SparseMatrix<double>> *sparse_bicg;
-		};
+		// The backend of the selected method owns its factorization (or Krylov solver), at most one
+		// of them is allocated at a time and release() frees it before the next analyze()
+		// LU
+		std::unique_ptr<Eigen::PartialPivLU<Eigen::Ref<Eigen::MatrixXd>>> lu;
+		std::unique_ptr<Eigen::SparseLU<Eigen::SparseMatrix<double>>> sparse_lu;
+		// Cholesky
+		std::unique_ptr<Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>>> cholesky;
+		std::unique_ptr<Eigen::SimplicialLLT<Eigen::SparseMatrix<double>, Eigen::Lower, Eigen::COLAMDOrdering<int>>> sparse_cholesky;
+		std::unique_ptr<OutOfCoreCholesky> sparse_cholesky_ooc;
+		// CG
+		std::unique_ptr<Eigen::ConjugateGradient<Eigen::MatrixXd, Eigen::Lower|Eigen::Upper>> cg;
+		std::unique_ptr<Eigen::ConjugateGradient<Eigen::SparseMatrix<double>, Eigen::Lower|Eigen::Upper>> sparse_cg;
+		// BiCG
+		std::unique_ptr<Eigen::BiCGSTAB<Eigen::MatrixXd>> bicg;
+		std::unique_ptr<Eigen::BiCGSTAB<Eigen::SparseMatrix<double>>> sparse_bicg;
+		// GMRES
+		std::unique_ptr<Eigen::GMRES<Eigen::MatrixXd>> gmres;
+		std::unique_ptr<Eigen::GMRES<Eigen::SparseMatrix<double>>> sparse_gmres;
+
+		// Single precision factorizations used by the mixed precision mode
+		std::unique_ptr<Eigen::PartialPivLU<Eigen::MatrixXf>> lu_f;
+		std::unique_ptr<Eigen::SparseLU<Eigen::SparseMatrix<float>>> sparse_lu_f;
+		std::unique_ptr<Eigen::LLT<Eigen::MatrixXf>> cholesky_f;
+		std::unique_ptr<Eigen::SimplicialLLT<Eigen::SparseMatrix<float>, Eigen::Lower, Eigen::COLAMDOrdering<int>>> sparse_cholesky_f;
+
+		// Solve functions of the backend, bound once by analyze() so that solve() does not select the method again
+		std::function<bool(const Eigen::VectorXd &)> solve_fn;
+		std::function<bool(const Eigen::MatrixXd &, Eigen::MatrixXd &)> block_solve_fn;
+		bool mixed_fallback; // Refinement stalled, the double precision factorization is used instead
 
 		struct {
 			double secs_in_solve_calls;
 			double secs_in_decompose_calls;
 			double secs_in_compute_calls;
+			double secs_in_scaling;
 			int solve_calls;
 			int decompose_calls;
 			int compute_calls;
+			int block_solve_calls;
+			int block_solve_rhs;
+			int refinement_steps;
+			int mixed_fallbacks;
+			int factorization_hits; // Matrices found in the factorization cache
+			int factorization_misses;
+			int factorization_evictions;
+			long iterations;
 		} perf_counter;
 
 		Solver(SparseSystem &sparse_system, options_t &options, Logger &logger)
@@ -104,14 +193,30 @@ namespace spic {
 
 			perf_counter.secs_in_decompose_calls = 0;
 			perf_counter.secs_in_compute_calls = 0;
+			perf_counter.secs_in_scaling = 0;
 			perf_counter.secs_in_solve_calls = 0;
 			perf_counter.decompose_calls = 0;
 			perf_counter.compute_calls = 0;
 			perf_counter.solve_calls = 0;
+			perf_counter.block_solve_calls = 0;
+			perf_counter.block_solve_rhs = 0;
+			perf_counter.refinement_steps = 0;
+			perf_counter.mixed_fallbacks = 0;
+			perf_counter.factorization_hits = 0;
+			perf_counter.factorization_misses = 0;
+			perf_counter.factorization_evictions = 0;
+			perf_counter.iterations = 0;
+
+			schur.active = false;
+			scaling.active = false;
 
 			/* Set the Solver method */
 			if (options.iter) {
-				if (options.spd) {
+				if (options.gmres) {
+					method = GMRES;
+				} else if (options.bicgstab) {
+					method = BiCGSTAB;
+				} else if (options.spd) {
 					method = CG;
 				} else {
 					method = BiCG;
@@ -129,40 +234,105 @@ namespace spic {
 		/* Wrappers for setting up the solver and then solving the system */
 		void analyze();
 		void solve(const Eigen::VectorXd &b);
+		void solve(const Eigen::MatrixXd &B, Eigen::MatrixXd &X);
+		void set_tolerance(double tol);
+		bool concurrent_solves();
+		void concurrent_solve(const Eigen::MatrixXd &B, Eigen::MatrixXd &X);
 		void dump_perf_counters(std::filesystem::path &filename, double g_time);
+		void add_perf_counters(const Solver &other);
 
 
 		/* All functions except the constructor, analyze, solve and dump_performance_counters are private */
 		private:
 		bool decompose();
 		void compute();
+		void release();
+		void bind_solve();
+		void solve_system(const Eigen::VectorXd &b);
+		void solve_system(const Eigen::MatrixXd &B, Eigen::MatrixXd &X);
 
 		/* LU custom and integrated decompose and solve functions*/
 		bool LU_custom_decompose();
 		void LU_custom_solve(const Eigen::VectorXd &b);
+		void LU_custom_solve(const Eigen::MatrixXd &B, Eigen::MatrixXd &X);
 		bool LU_integrated_decompose();
-		void LU_integrated_solve(const Eigen::VectorXd &b);
 
 		/* Cholesky custom and integrated decompose and solve functions*/
 		bool cholesky_integrated_decompose();
-		void cholesky_integrated_solve(const Eigen::VectorXd &b);
 		bool cholesky_custom_decompose();
 		void cholesky_custom_solve(const Eigen::VectorXd &b);
+		void cholesky_custom_solve(const Eigen::MatrixXd &B, Eigen::MatrixXd &X);
 
 		/* Conjugate gradient custom and integrated solve functions */
 		void CG_integrated_compute();
-		void CG_integrated_solve(const Eigen::VectorXd &b);
 		void CG_custom_compute();
-		void CG_custom_solve(const Eigen::VectorXd &b);
+		void CG_custom_solve(const Eigen::VectorXd &b, Eigen::VectorXd &x);
+		template <typename Matrix>
+		void CG_custom_solve(const Matrix &A, const Eigen::MatrixXd &B, Eigen::MatrixXd &X);
+		void CG_deflated_solve(const Eigen::VectorXd &b, Eigen::VectorXd &x);
+		void deflation_harvest(const Eigen::MatrixXd &P);
 
 		/* BiConjugate gradient custom and integrated solve functions */
 		void BiCG_integrated_compute();
-		void BiCG_integrated_solve(const Eigen::VectorXd &b);
 		void BiCG_custom_compute();
-		bool BiCG_custom_solve(const Eigen::VectorXd &b);
+		template <typename Matrix>
+		bool BiCG_custom_solve(const Matrix &A, const Eigen::VectorXd &b, Eigen::VectorXd &x);
+
+		/* BiCGSTAB custom solve functions, the integrated version is the integrated BiCG */
+		void BiCGSTAB_custom_compute();
+		bool BiCGSTAB_custom_solve(const Eigen::VectorXd &b, Eigen::VectorXd &x);
+
+		/* Restarted GMRES custom and integrated solve functions */
+		void GMRES_integrated_compute();
+		void GMRES_custom_compute();
+		bool GMRES_custom_solve(const Eigen::VectorXd &b, Eigen::VectorXd &x);
+
+		/* Mixed precision decompose and solve functions */
+		bool mixed_decompose();
+		template <typename FactorizationF, typename Factorization, typename Matrix>
+		void mixed_solve(std::unique_ptr<FactorizationF> &factorization_f, std::unique_ptr<Factorization> &factorization,
+						 const Matrix &A, const Eigen::MatrixXd &B, Eigen::MatrixXd &X);
+
+		/* Solve functions bound by bind_solve() to the factorization or Krylov solver of the storage in use */
+		template <typename Factorization>
+		void bind_direct(Factorization &factorization, Eigen::VectorXd &x);
+		template <typename Krylov>
+		void bind_krylov(Krylov &krylov, Eigen::VectorXd &x);
+		template <typename FactorizationF, typename Factorization, typename Matrix>
+		void bind_mixed(std::unique_ptr<FactorizationF> &factorization_f, std::unique_ptr<Factorization> &factorization,
+						const Matrix &A, Eigen::VectorXd &x);
+
+		/* Domain decomposition (Schur complement) decompose and solve functions */
+		bool schur_partition();
+		bool schur_decompose();
+		void schur_solve(const Eigen::MatrixXd &B, Eigen::MatrixXd &X);
+		Eigen::MatrixXd schur_interior_solve(int d, const Eigen::MatrixXd &B);
+
+		/* Fused vector kernels of the custom CG and BiCG */
+		double jacobi_residual(const Eigen::VectorXd &b, const Eigen::VectorXd &q, Eigen::VectorXd &r, double &rr);
+		void jacobi_direction(const Eigen::VectorXd &r, double beta, Eigen::VectorXd &p);
+		double cg_update(double alpha, const Eigen::VectorXd &p, const Eigen::VectorXd &q,
+						 Eigen::VectorXd &x, Eigen::VectorXd &r, double &rr);
+		void bicg_direction(const Eigen::VectorXd &r, const Eigen::VectorXd &r_tilda, double beta,
+							Eigen::VectorXd &p, Eigen::VectorXd &p_tilda);
+		double bicg_update(double alpha, const Eigen::VectorXd &p, const Eigen::VectorXd &q,
+						   const Eigen::VectorXd &q_tilda, Eigen::VectorXd &x, Eigen::VectorXd &r,
+						   Eigen::VectorXd &r_tilda, double &rr);
 
 		/* Helper functions */
-		void prune_output_vector();
+		void equilibrate();
+		void prune_output_vector(Eigen::VectorXd &x);
+		void jacobi_preconditioner_compute();
+		void partition_compute();
+		void first_touch(Eigen::VectorXd &v);
+		void csr_compute();
+		void spmv(const Eigen::VectorXd &p, Eigen::VectorXd &q);
+		double spmv_dot(const Eigen::VectorXd &p, Eigen::VectorXd &q, const Eigen::VectorXd *w);
+		void spmv_transpose(const Eigen::SparseMatrix<double> &A, const Eigen::VectorXd &p, Eigen::VectorXd &q);
+		void spmv_transpose(const Eigen::MatrixXd &A, const Eigen::VectorXd &p, Eigen::VectorXd &q);
+		int gmres_restart();
+		template <typename ColumnSolve>
+		bool solve_columns(const Eigen::MatrixXd &B, Eigen::MatrixXd &X, ColumnSolve column_solve);
 
 	};
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include <Eigen/Core>
 
 // TODO: Maybe move System in a system.cpp and rename system.cpp to mna_system.cpp
@@ -49,34 +51,50 @@ namespace spic {
 		public:
 		transient_method_t transient_method;
 		MNASystem &mna_system;
-		Eigen::MatrixXd G;
-		Eigen::MatrixXd C;
+		// Storage of G and C, shared with the transient systems created from this one
+		std::shared_ptr<Eigen::MatrixXd> G_ptr, C_ptr;
+		Eigen::MatrixXd &G;
+		Eigen::MatrixXd &C;
 		Eigen::VectorXd dc_source_vector;
+		bool dc_overwritten; // A has been replaced by a transient matrix
 
 		// Constructor: Copy the A matrix to the G matrix to be kept
 		// calculate the C matrix, A will be used to store the transient system 
 		MNASystemTransient(transient_method_t transient_method, MNASystem &mna_system) :
-						transient_method(transient_method),
-						G(mna_system.A), C(mna_system.n, mna_system.n), 
-						mna_system(mna_system), dc_source_vector(mna_system.b)
+						transient_method(transient_method), mna_system(mna_system),
+						G_ptr(std::make_shared<Eigen::MatrixXd>(mna_system.A)),
+						C_ptr(std::make_shared<Eigen::MatrixXd>(mna_system.n, mna_system.n)),
+						G(*G_ptr), C(*C_ptr), dc_source_vector(mna_system.b), dc_overwritten(false)
 		{
 			C.setZero();
 			create_initial_tran_system();
 		}
 
-		// Destructor: Copy the G matrix back to the A matrix to be used for DC analysis
-		// also copy the dc_source_vector back to the b vector
+		// Constructor: Share G and C of another transient system, mna_system is a copy
+		// of the system of the other one, so that the two can run concurrently
+		MNASystemTransient(MNASystemTransient &shared, MNASystem &mna_system) :
+						transient_method(shared.transient_method), mna_system(mna_system),
+						G_ptr(shared.G_ptr), C_ptr(shared.C_ptr),
+						G(*G_ptr), C(*C_ptr), dc_source_vector(shared.dc_source_vector), dc_overwritten(false) {}
+
+		// Destructor: Copy the G matrix back to the A matrix to be used for DC analysis, unless
+		// A was never replaced (so its DC factorization is still valid), and copy the
+		// dc_source_vector back to the b vector
 		~MNASystemTransient()
 		{
-			mna_system.A = G;
+			if (dc_overwritten) {
+				mna_system.A = G;
+			}
 			mna_system.b = dc_source_vector;
 		}
 
 		void create_initial_tran_system();
 		void create_tran_system(double time_step);
+		double tran_alpha(double time_step);
 
 		void update_tran_system_tr(Eigen::VectorXd &e_new, Eigen::VectorXd &e_old, double time_step);
 		void update_tran_system_be(Eigen::VectorXd &e, double time_step);
+		void update_tran_system_gear(Eigen::VectorXd &e, Eigen::VectorXd &x_prev, double time_step);
 
 		void add_capacitor_stamp(node_id_t node_positive, node_id_t node_negative, float value);
 		void add_inductor_stamp(int voltage_src_id, float value);
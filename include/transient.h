@@ -1,13 +1,35 @@
 #pragma once
 
 #include <vector>
+#include <deque>
+#include <list>
+#include <memory>
+#include <new>
+#include <queue>
+#include <tuple>
 #include <cmath>
 #include <cassert>
 #include <ostream>
 
 #include "solver.h"
 
+#define MAX_PREDICTOR_ORDER 2 // Highest order of the polynomial predictor of iterative transient solves
+#define PREDICTOR_TOL_FACTOR 1e-5 // Tolerance of a predicted step relative to its predicted change of the solution (at least ITOL)
+#define TRAN_MIN_STEP_LEVEL -10 // Smallest adaptive step is time_step / 2^10
+#define TRAN_MAX_STEP_LEVEL 10 // Largest adaptive step is time_step * 2^10
+#define TRAN_MAX_STEP_GROWTH 2 // Levels the adaptive step may be raised by after an accepted step
+#define TRAN_STEP_SOLVERS 8 // Step sizes whose factorization is kept by an adaptive transient analysis
+#define TRAN_LTE_SAFETY 0.8 // Fraction of the step allowed by the truncation error estimate that is taken
+#define TRAN_JOBS_MEMORY_FRACTION 0.5 // Fraction of the available memory that concurrent transient analyses may use
+#define TRAN_FILL_ESTIMATE 8 // Assumed ratio of the non zeros of a sparse factorization to those of A
+#define EXP_MAX_KRYLOV_DIM 40 // Largest Krylov subspace of the exponential transient method
+#define EXP_KRYLOV_TOL 1e-8 // Error of the Krylov approximation of e^(hJ)v relative to |v|
+#define PARAREAL_TOL 1e-6 // Largest change of the slice boundary solutions, relative to 1 + |x|, of a converged Parareal iteration
+
 namespace spic {
+	class FactorizationCache;
+	class Scenario;
+
 	/* Transiet Specifcation of Source elements */
 	class TransientSpecs {
 		public:
@@ -67,6 +89,7 @@ namespace spic {
 		{
 			assert(type == PWL);
 			pwl.points = points;
+			new (&pwl.slopes) std::vector<double>(); // Union members are not constructed implicitly
 
 			for (int i = 0; i < pwl.points->size() - 1; i++) {
 				double dt = (*pwl.points)[i + 1].first - (*pwl.points)[i].first;
@@ -79,10 +102,13 @@ namespace spic {
 		{
 			if (type == PWL) {
 				delete pwl.points;
+				pwl.slopes.~vector();
 			}
 		}
 
 		double eval(double t);
+		double next_breakpoint(double t);
+		std::vector<double> parameters();
 		private:
 		double exp_eval(double t);
 		double sin_eval(double t);
@@ -90,6 +116,70 @@ namespace spic {
 		double pwl_eval(double t);
 	};
 
+	/* Yields the breakpoints (corners) of the given waveforms in increasing order, rounded to
+	 * multiples of resolution so that corners closer than that are merged. Every waveform keeps only
+	 * its next corner in the priority queue, the following one is added when it is passed.
+	 */
+	class BreakpointScheduler {
+		public:
+		BreakpointScheduler(double resolution, const std::vector<TransientSpecs *> &waveforms);
+
+		long next(long tick); // First breakpoint after tick, in multiples of resolution
+
+		private:
+		typedef std::tuple<long, double, TransientSpecs *> breakpoint_t; // (tick, time, waveform)
+
+		double resolution;
+		std::priority_queue<breakpoint_t, std::vector<breakpoint_t>, std::greater<breakpoint_t>> queue;
+
+		void push(TransientSpecs *specs, double t);
+	};
+
+	/* Evaluates the source vector of the MNA system at a time point. The sources without a waveform
+	 * are stamped once into a constant vector, the rest are grouped by waveform type with their
+	 * parameters in arrays (structure of arrays), so that each group is evaluated with vectorized
+	 * exp/sin. Sources with identical waveforms share a single one, which is evaluated once, and the
+	 * values are added on top of the constant vector through the incidence matrix of the stamps.
+	 * The sources of a scenario, if one is given, replace those of the netlist with the same names.
+	 */
+	class SourceEvaluator {
+		public:
+		SourceEvaluator(int n, int total_nodes, Scenario *scenario = NULL);
+
+		void eval(double t, Eigen::VectorXd &source_vector);
+
+		int sources; // Sources with a waveform
+		int waveforms; // Distinct waveforms among them
+		std::vector<TransientSpecs *> distinct; // The distinct waveforms, in the order of values
+
+		private:
+		Eigen::VectorXd dc_vector; // Stamps of the sources without a waveform
+
+		struct {
+			Eigen::ArrayXd i1, idiff, td1, tc1, td2, tc2;
+		} exp;
+
+		struct {
+			Eigen::ArrayXd i1, ia, td, df, initial_phase, omega;
+		} sin;
+
+		struct {
+			Eigen::ArrayXd i1, i2, td, tr, tf, per, diff, peak, fall_start, fall_end;
+		} pulse;
+
+		struct {
+			std::vector<TransientSpecs *> specs;
+			std::vector<int> cursors; // Segment of the last evaluation, the time moves mostly forward
+		} pwl;
+
+		Eigen::ArrayXd values; // Values of the waveforms, in the order EXP, SIN, PULSE, PWL
+
+		// Signed stamps of the waveforms, source_vector = dc_vector + incidence * values
+		Eigen::SparseMatrix<double> incidence;
+
+		double pwl_eval(TransientSpecs *specs, int &cursor, double t);
+	};
+
 	/* Transient Analysis Command Struct */
 	class TransientAnalysis {
 		public:
@@ -101,8 +191,11 @@ namespace spic {
 			MNASparseSystemTransient *tran_mna_sparse_system;
 		};
 
+		// Factorizations of G + alpha * C shared with the other analyses (NULL factors every matrix)
+		FactorizationCache *cache;
+
 		TransientAnalysis(double time_step, double fin_time) :
-			time_step(time_step), fin_time(fin_time)
+			time_step(time_step), fin_time(fin_time), cache(NULL)
 		{
 			tran_mna_system = NULL;
 		}
@@ -111,10 +204,13 @@ namespace spic {
 
 		void load_system(MNASystemTransient *system);
 		void load_system(MNASparseSystemTransient *system);
+		void load_cache(FactorizationCache *factorizations);
 
 		Eigen::VectorXd &solve_curr_step(Solver &solver,
 										Eigen::VectorXd **curr_source_vector_ptr,
-										Eigen::VectorXd **prev_source_vector_ptr);
+										Eigen::VectorXd **prev_source_vector_ptr,
+										std::deque<Eigen::VectorXd> &history,
+										Eigen::VectorXd &prev_solution);
 
 		void run(Solver &solver,
 				std::vector<std::string> &prints,
@@ -123,14 +219,65 @@ namespace spic {
 				Logger &logger);
 
 		private:
-		void calculate_source_vector(Eigen::VectorXd &source_vector, int total_nodes, double time);
+		// Solver of A = G + alpha * C for the adaptive step time_step * 2^level, on its own copy of A
+		typedef struct step_solver {
+			int level;
+			std::unique_ptr<System> system;
+			std::unique_ptr<SparseSystem> sparse_system;
+			std::unique_ptr<Solver> solver;
+		} step_solver_t;
+
+		void run_adaptive(Solver &solver,
+						SourceEvaluator &sources,
+						std::vector<std::string> &unique_vector,
+						std::unordered_map<std::string, std::vector<double>> &transient_data,
+						std::vector<double> &transient_times,
+						std::vector<int> &transient_iterations,
+						std::vector<double> &iteration_times,
+						Logger &logger);
+		void run_exponential(Solver &solver,
+							SourceEvaluator &sources,
+							std::vector<std::string> &unique_vector,
+							std::unordered_map<std::string, std::vector<double>> &transient_data,
+							std::vector<double> &transient_times,
+							std::vector<int> &transient_iterations,
+							std::vector<double> &iteration_times,
+							Logger &logger);
+		void run_scenarios(Solver &solver,
+						std::vector<std::string> &unique_vector,
+						std::filesystem::path transient_dir,
+						std::vector<std::string> &plots,
+						Logger &logger);
+		int exp_krylov(Solver &shift_solver, double gamma, double h, Eigen::VectorXd &v, int &iterations);
+		void run_parareal(Solver &solver,
+						SourceEvaluator &sources,
+						std::vector<std::string> &unique_vector,
+						std::unordered_map<std::string, std::vector<double>> &transient_data,
+						std::vector<double> &transient_times,
+						std::vector<int> &transient_iterations,
+						std::vector<double> &iteration_times,
+						Logger &logger);
+		void parareal_fine(Solver &fine_solver, bool shared, SourceEvaluator &sources, Eigen::VectorXd &x,
+						int k_begin, int k_end, const std::vector<int> &node_ids, Eigen::MatrixXd &outputs,
+						std::vector<int> &iterations);
+		void build_step_solver(step_solver_t &s, double alpha, Solver &solver);
+		Solver &get_step_solver(std::list<step_solver_t> &step_solvers, int level, Solver &solver, int &factorizations);
+		double lte_norm(const std::deque<double> &times, const std::deque<Eigen::VectorXd> &solutions,
+						const Eigen::VectorXd &x, double t, int order);
+
+		void predict_solution(std::deque<Eigen::VectorXd> &history, Eigen::VectorXd &x);
 		std::string get_transient_name(std::string print_node);
+		std::string get_iterations_name();
 
 		void dump_results(std::unordered_map<std::string, std::vector<double>> transient_data,
 											std::vector<double>                                  transient_times,
 											std::vector<std::string>                             unique_vector,
 											std::filesystem::path                                transient_dir);
 
+		void dump_iterations(std::vector<int>        transient_iterations,
+							std::vector<double>     transient_times,
+							std::filesystem::path   transient_dir);
+
 		void plot_results(std::vector<std::string> &plots,
 						Logger                   &logger,
 						std::filesystem::path    transient_dir);
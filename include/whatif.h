@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include <Eigen/Core>
+
+#include "solver.h"
+
+namespace spic {
+	/* A variant of the circuit with a few changed elements, solved against the factorization
+	 * of the original MNA matrix with the Sherman-Morrison-Woodbury formula
+	 */
+	class WhatIf {
+		public:
+		typedef struct resistor_change {
+			int node_positive; // MNA row of the positive node (-1 for ground)
+			int node_negative; // MNA row of the negative node (-1 for ground)
+			double delta_conductance;
+		} resistor_change_t;
+
+		std::vector<std::string> descriptions; // Changes as they were given, e.g. R1=100
+		std::vector<resistor_change_t> resistor_changes;
+		std::vector<std::pair<int, double>> source_changes; // Changes of b, as (row, delta)
+
+		bool change_resistor(std::string &name, double value);
+		bool change_voltage_source(std::string &name, double value);
+		bool change_current_source(std::string &name, double value);
+
+		void solve(Solver *solver, const Eigen::VectorXd &b, Eigen::VectorXd &x);
+
+		void dump_results(Eigen::VectorXd &x, std::filesystem::path filename);
+
+		private:
+		bool is_changed(const std::string &element);
+	};
+}
+
+std::ostream& operator<<(std::ostream &out, const spic::WhatIf &whatif);
+std::ostream& operator<<(std::ostream &out, const std::vector<spic::WhatIf> &whatifs);
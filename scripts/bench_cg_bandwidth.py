@@ -0,0 +1,59 @@
+# Script that measures the time and the memory bandwidth per iteration of the custom CG on a synthetic
+# power grid, for every combination of thread counts and OMP_PROC_BIND policies. On a multi-socket node
+# the row blocks of the partitioned kernels are placed on the NUMA node of their thread only when the
+# threads are bound, thus the bound and unbound runs show what the first touch placement gives.
+# Usage: python3 bench_cg_bandwidth.py --size 1000 --threads 1 8 16 32 --binds false close spread
+
+import argparse
+import os
+import subprocess
+import tempfile
+
+def read_performance_report(path):
+	counters = {}
+	with open(path, 'r') as file:
+		for line in file:
+			name, value = line.split(':')
+			counters[name.strip()] = float(value)
+	return counters
+
+def main():
+	parser = argparse.ArgumentParser(description="Measure the per iteration bandwidth of the custom CG")
+	parser.add_argument("--size", type=int, default=1000, help="Nodes per side of the synthetic grid")
+	parser.add_argument("--threads", type=int, nargs='+', default=[1], help="Thread counts to run with")
+	parser.add_argument("--binds", nargs='+', default=["false", "spread"], help="OMP_PROC_BIND policies to run with")
+	parser.add_argument("--itol", default="1e-6", help="Iteration tolerance")
+	parser.add_argument("--spic", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "../build/spic"),
+						help="Path to the spic binary")
+	args = parser.parse_args()
+
+	script_dir = os.path.dirname(os.path.realpath(__file__))
+	work_dir = tempfile.mkdtemp(prefix="bench_cg_")
+	cir_file = os.path.join(work_dir, "grid.cir")
+	subprocess.run(["python3", os.path.join(script_dir, "make_grid.py"), "--size", str(args.size), "--norton",
+					"--output", cir_file], check=True)
+
+	# CSR values and column indices, row pointers, and the vectors streamed by the three passes of an
+	# iteration: direction (r, M^-1, p read and p written), SpMV (p gathered, q written) and update
+	# (x, p, q, r, M^-1 read and x, r written)
+	n = args.size * args.size
+	nnz = n + 4 * args.size * (args.size - 1)
+	bytes_per_iteration = nnz * (8 + 4) + (n + 1) * 4 + 13 * n * 8
+
+	print(f"{n} unknowns, {nnz} non zeros, {bytes_per_iteration / 1e6:.1f} MB per iteration")
+	print(f"{'threads':>8} {'bind':>8} {'iterations':>11} {'us/iter':>10} {'GB/s':>8}")
+	for bind in args.binds:
+		for threads in args.threads:
+			output_dir = os.path.join(work_dir, f"out_{bind}_{threads}")
+			env = dict(os.environ, OMP_NUM_THREADS=str(threads), OMP_PROC_BIND=bind, OMP_PLACES="cores")
+			subprocess.run([args.spic, "--cir_file", cir_file, "--output_dir", output_dir, "--bypass_options",
+							"--sparse", "--iter", "--spd", "--custom", f"--itol={args.itol}"],
+						   env=env, stdout=subprocess.DEVNULL, check=True)
+
+			counters = read_performance_report(os.path.join(output_dir, "spic_performance.rpt"))
+			secs = counters["secs_in_solve"] / max(counters["iterations"], 1)
+			print(f"{threads:>8} {bind:>8} {int(counters['iterations']):>11} {secs * 1e6:>10.1f} "
+				  f"{bytes_per_iteration / secs / 1e9:>8.2f}")
+
+if __name__ == "__main__":
+	main()
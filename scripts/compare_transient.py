@@ -0,0 +1,67 @@
+# Script that compares the transient outputs of two spic output directories: every .dat file under the
+# transient subdirectory of the first one (including the scenario_<i> subdirectories) is compared with the
+# file of the same name in the second one, point by point at the same times. The error of a point is
+# relative to the largest absolute value of the reference waveform, so that waveforms crossing zero are not
+# blown up. With --scenario <i> the outputs of scenario i of the second directory are compared instead.
+# Exits with 1 if a file is missing, the time points differ, or an error is above --tol.
+# Usage: python3 compare_transient.py <reference_dir> <output_dir> [--tol 1e-3] [--scenario <i>]
+
+import argparse
+import os
+import sys
+import numpy as np
+
+def read_waveform(path):
+	data = np.loadtxt(path, ndmin=2)
+	return data[:, 0], data[:, 1]
+
+def main():
+	parser = argparse.ArgumentParser(description="Compare the transient outputs of two spic output directories")
+	parser.add_argument("reference_dir", help="Output directory of the reference run")
+	parser.add_argument("output_dir", help="Output directory of the run under test")
+	parser.add_argument("--tol", type=float, default=1e-3, help="Largest error allowed, relative to the waveform")
+	parser.add_argument("--scenario", type=int, help="Compare the outputs of this scenario of output_dir")
+	args = parser.parse_args()
+
+	reference_root = os.path.join(args.reference_dir, "transient")
+	output_root = os.path.join(args.output_dir, "transient")
+	if args.scenario is not None:
+		output_root = os.path.join(output_root, f"scenario_{args.scenario}")
+	failed = False
+	worst = 0
+	files = 0
+
+	for root, _, names in sorted(os.walk(reference_root)):
+		for name in sorted(names):
+			if not name.endswith(".dat") or name.endswith("_iterations.dat"):
+				continue
+			relative = os.path.relpath(os.path.join(root, name), reference_root)
+			output_file = os.path.join(output_root, relative)
+			if not os.path.isfile(output_file):
+				print(f"{relative}: missing")
+				failed = True
+				continue
+
+			t_ref, v_ref = read_waveform(os.path.join(root, name))
+			t_out, v_out = read_waveform(output_file)
+			if len(t_ref) != len(t_out) or not np.allclose(t_ref, t_out, rtol=1e-9, atol=0):
+				print(f"{relative}: time points differ")
+				failed = True
+				continue
+
+			scale = max(np.max(np.abs(v_ref)), 1e-12)
+			error = np.max(np.abs(v_out - v_ref)) / scale
+			worst = max(worst, error)
+			files += 1
+			if error > args.tol:
+				print(f"{relative}: error {error:.3e} above {args.tol:.1e}")
+				failed = True
+
+	if files == 0 and not failed:
+		print("No transient outputs to compare")
+		failed = True
+	print(f"Compared {files} waveforms, largest error {worst:.3e}")
+	sys.exit(1 if failed else 0)
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,63 @@
+# Script that writes a synthetic power grid deck in the style of the IBM power grid benchmarks:
+# a size x size mesh of resistors with a current load on every node and supply pads every pad_pitch
+# nodes. With --caps every node also gets a capacitor to ground and the loads switch with PULSE
+# waveforms, so that the deck can be used for the transient analyses.
+# Usage: python3 make_grid.py --size 100 --output grid.cir [OPTIONS]
+
+import argparse
+import random
+
+def main():
+	parser = argparse.ArgumentParser(description="Write a synthetic power grid circuit file")
+	parser.add_argument("--size", type=int, default=100, help="Nodes per side of the mesh")
+	parser.add_argument("--pad_pitch", type=int, default=10, help="Distance in nodes between the supply pads")
+	parser.add_argument("--norton", action='store_true', help="Model the pads as current sources with a resistor (SPD matrix)")
+	parser.add_argument("--caps", type=float, default=0, help="Capacitance of every node to ground (0 disables the transient parts)")
+	parser.add_argument("--period", type=float, default=2e-9, help="Period of the PULSE loads")
+	parser.add_argument("--tran", type=float, nargs=2, metavar=("STEP", "FIN"), help="Add a .TRAN with the given step and final time")
+	parser.add_argument("--options", default="", help="Contents of the .OPTIONS line")
+	parser.add_argument("--prints", type=int, default=4, help="Number of nodes in the .PRINT line")
+	parser.add_argument("--seed", type=int, default=1, help="Seed of the random loads")
+	parser.add_argument("--output", required=True, help="Path of the circuit file")
+	args = parser.parse_args()
+
+	random.seed(args.seed)
+	n = args.size
+	node = lambda i, j: f"n{i}_{j}"
+	vdd, r_pad, r_seg = 1.8, 0.01, 0.5
+
+	with open(args.output, 'w') as f:
+		f.write(f"* Synthetic {n}x{n} power grid\n")
+		for i in range(n):
+			for j in range(n):
+				if j + 1 < n:
+					f.write(f"RH{i}_{j} {node(i, j)} {node(i, j + 1)} {r_seg * random.uniform(0.8, 1.2):g}\n")
+				if i + 1 < n:
+					f.write(f"RV{i}_{j} {node(i, j)} {node(i + 1, j)} {r_seg * random.uniform(0.8, 1.2):g}\n")
+
+				load = random.uniform(1e-4, 1e-3)
+				if args.caps > 0:
+					f.write(f"C{i}_{j} {node(i, j)} 0 {args.caps:g}\n")
+					td, edge, per = random.uniform(0, args.period), args.period / 20, args.period
+					f.write(f"I{i}_{j} {node(i, j)} 0 {load:g} PULSE ({load / 10:g} {load:g} {td:g} {edge:g} {edge:g} {per / 4:g} {per:g})\n")
+				else:
+					f.write(f"I{i}_{j} {node(i, j)} 0 {load:g}\n")
+
+				if i % args.pad_pitch == 0 and j % args.pad_pitch == 0:
+					if args.norton:
+						f.write(f"RP{i}_{j} {node(i, j)} 0 {r_pad:g}\n")
+						f.write(f"IP{i}_{j} 0 {node(i, j)} {vdd / r_pad:g}\n")
+					else:
+						f.write(f"RP{i}_{j} {node(i, j)} p{i}_{j} {r_pad:g}\n")
+						f.write(f"VP{i}_{j} p{i}_{j} 0 {vdd:g}\n")
+
+		if args.options:
+			f.write(f".OPTIONS {args.options}\n")
+		if args.tran:
+			f.write(f".TRAN {args.tran[0]:g} {args.tran[1]:g}\n")
+			step = max(1, n * n // args.prints)
+			f.write(".PRINT " + " ".join(f"V({node(k // n, k % n)})" for k in range(0, n * n, step)[:args.prints]) + "\n")
+		f.write(".END\n")
+
+if __name__ == "__main__":
+	main()
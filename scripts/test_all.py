@@ -22,10 +22,10 @@ import argparse
 import csv
 from prettytable import PrettyTable
 
-from test_cir import get_version_name
+from test_cir import add_spic_option_arguments, spic_option_flags, get_args_version_name
 
 
-def run_tests(tests_dir, custom, sparse, iter_methods, itol, version_num):
+def run_tests(tests_dir, custom, sparse, iter_methods, itol, version_num, option_flags):
 	# Compute average error for each test
 	tests = sorted(os.listdir(tests_dir))
 	for test in tests:
@@ -45,6 +45,7 @@ def run_tests(tests_dir, custom, sparse, iter_methods, itol, version_num):
 					continue
 				params.append("--iter")
 				params.append(f"--itol={itol}")
+			params += option_flags
 
 			test_path = os.path.join(tests_dir, test)
 			print('Running test', test_path)
@@ -83,15 +84,16 @@ def main():
 	parser.add_argument("--iter",	action='store_true', help="Enable iterative solver option")
 	parser.add_argument('--itol', help='Tolerance for iterative solver', default='1e-3')
 	parser.add_argument("--version", help="Version of evaluation", default="0")
+	add_spic_option_arguments(parser)
 
 	args = parser.parse_args()
 	tests_dir = args.tests_dir
-	version_str = get_version_name(args.custom, args.sparse, args.iter, args.version)
+	version_str = get_args_version_name(args)
 
 	if args.sparse and not args.iter and args.custom:
 		raise ValueError("Sparse matrix option is only available for custom iterative solver")
 
-	run_tests(tests_dir, args.custom, args.sparse, args.iter, args.itol, args.version)
+	run_tests(tests_dir, args.custom, args.sparse, args.iter, args.itol, args.version, spic_option_flags(args))
 	results = read_csv_files(tests_dir, version_str)
 
 	# Write results to CSV
@@ -2,7 +2,8 @@ import subprocess
 import os
 import argparse
 
-def get_version_name(custom, sparse, iter_solver, version_num):
+def get_version_name(custom, sparse, iter_solver, version_num, gmres=False, bicgstab=False, scale=False,
+					 deflation=0, transient_method=None, ltetol=None, parareal=None):
 	version = []
 	if custom:
 		version.append("CUSTOM")
@@ -13,9 +14,56 @@ def get_version_name(custom, sparse, iter_solver, version_num):
 		version.append("SPARSE")
 	if iter_solver:
 		version.append("ITER")
+	if gmres:
+		version.append("GMRES")
+	if bicgstab:
+		version.append("BICGSTAB")
+	if deflation:
+		version.append(f"DEFLATION{deflation}")
+	if scale:
+		version.append("SCALE")
+	if transient_method:
+		version.append(transient_method)
+	if ltetol:
+		version.append(f"LTETOL{ltetol}")
+	if parareal:
+		version.append(f"PARAREAL{parareal}")
 	version.append(version_num)
 	return "_".join(version)
 
+# Arguments of the spic options that are also passed from test_all.py to test_cir.py
+def add_spic_option_arguments(parser):
+	parser.add_argument("--gmres", action='store_true', help="Enable GMRES iterative solver option")
+	parser.add_argument("--bicgstab", action='store_true', help="Enable BiCGSTAB iterative solver option")
+	parser.add_argument("--scale", action='store_true', help="Enable SCALE (equilibration) option")
+	parser.add_argument("--deflation", type=int, default=0, help="Number of DEFLATION vectors of CG")
+	parser.add_argument("--transient_method", choices=["TR", "BE", "GEAR", "EXP"], default=None,
+						help="Set transient method")
+	parser.add_argument("--ltetol", default=None, help="Set LTETOL of the adaptive time step")
+	parser.add_argument("--parareal", default=None, help="Set number of PARAREAL time slices")
+
+def spic_option_flags(args):
+	flags = []
+	if args.gmres:
+		flags.append("--gmres")
+	if args.bicgstab:
+		flags.append("--bicgstab")
+	if args.scale:
+		flags.append("--scale")
+	if args.deflation:
+		flags.append(f"--deflation={args.deflation}")
+	if args.transient_method:
+		flags.append(f"--transient_method={args.transient_method}")
+	if args.ltetol:
+		flags.append(f"--ltetol={args.ltetol}")
+	if args.parareal:
+		flags.append(f"--parareal={args.parareal}")
+	return flags
+
+def get_args_version_name(args):
+	return get_version_name(args.custom, args.sparse, args.iter, args.version, args.gmres, args.bicgstab, args.scale,
+							args.deflation, args.transient_method, args.ltetol, args.parareal)
+
 def main():
 	parser = argparse.ArgumentParser(description="Run spic with circuit file and process output to make csv with errors.")
 	parser.add_argument("--cir_file", help="Path to the circuit file", default=None)
@@ -27,6 +75,7 @@ def main():
 	parser.add_argument("--itol", help="Set iteration tolernace", default="1e-3")
 	parser.add_argument("--disable_dc_sweeps",	action='store_true', help="Disable DC Sweeps")
 	parser.add_argument("--version", help="Version of evaluation", default="0")
+	add_spic_option_arguments(parser)
 	
 	args = parser.parse_args()
 	
@@ -53,8 +102,9 @@ def main():
 	if disable_dc_sweeps:
 		spic_option_args.append("--disable_dc_sweeps")
 		cmp_dirs_args.append("--disable_dc_sweeps")
+	spic_option_args += spic_option_flags(args)
 
-	version = get_version_name(custom, sparse, iter_solver, args.version)
+	version = get_args_version_name(args)
 
 	test_name = cir_file.removesuffix(".cir").split("/")[-1]
 	spic_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
@@ -0,0 +1,71 @@
+# Script that checks the distributed memory MPI mode against the serial custom CG. The circuit file is solved
+# once by the serial spic and then by the MPI build under mpirun with every given number of ranks, both with
+# SPARSE ITER SPD and the same ITOL. The .PRINT node voltages of every dc_op.dat of the MPI runs are compared
+# with the ones of the serial run, and the script exits with 1 if a node differs by more than --tol.
+# Usage: python3 test_mpi.py grid.cir [OPTIONS]
+
+import argparse
+import os
+import shlex
+import subprocess
+import sys
+
+# Node voltages of an operating point file, the source currents that dc_op.dat has after them are skipped
+def read_node_voltages(file_path):
+	voltages = {}
+	with open(file_path, 'r') as file:
+		for line in file:
+			if line.startswith("Source Current"):
+				break
+			if line.isspace() or line.startswith("Node Voltage"):
+				continue
+			node_name, voltage = line.split()
+			voltages[node_name] = float(voltage)
+	return voltages
+
+def run(command, cir_file):
+	result = subprocess.run(command, stdout=subprocess.DEVNULL)
+	if result.returncode != 0:
+		raise RuntimeError(f"{' '.join(command)} failed for cir_file {cir_file}")
+
+def main():
+	script_dir = os.path.dirname(os.path.abspath(__file__))
+	parser = argparse.ArgumentParser(description="Compare the MPI mode with the serial custom CG")
+	parser.add_argument("cir_file", help="Circuit file with SPD MNA matrix and .PRINT nodes")
+	parser.add_argument("--ranks", type=int, nargs='+', default=[2, 3], help="Numbers of MPI ranks to run")
+	parser.add_argument("--itol", type=float, default=1e-10, help="ITOL of the serial and the distributed CG")
+	parser.add_argument("--tol", type=float, default=1e-6, help="Largest relative error allowed")
+	parser.add_argument("--spic", default=os.path.join(script_dir, "../build/spic"), help="Path to the serial spic binary")
+	parser.add_argument("--spic_mpi", default=os.path.join(script_dir, "../build_mpi/spic"),
+						help="Path to the spic binary built with -DSPIC_MPI=ON")
+	parser.add_argument("--mpirun", default="mpirun", help="Launcher command, e.g. \"mpirun --oversubscribe\"")
+	parser.add_argument("--output_dir", default="mpi_output", help="Directory of the outputs of the runs")
+	args = parser.parse_args()
+
+	options = ["--bypass_options", "--sparse", "--iter", "--spd", "--itol", str(args.itol)]
+
+	serial_dir = os.path.join(args.output_dir, "serial")
+	run([args.spic, "--cir_file", args.cir_file, "--output_dir", serial_dir, "--custom"] + options, args.cir_file)
+	golden = read_node_voltages(os.path.join(serial_dir, "dc_op.dat"))
+
+	failed = False
+	for ranks in args.ranks:
+		mpi_dir = os.path.join(args.output_dir, f"np_{ranks}")
+		run(shlex.split(args.mpirun) + ["-np", str(ranks), args.spic_mpi, "--cir_file", args.cir_file,
+										"--output_dir", mpi_dir] + options, args.cir_file)
+
+		distributed = read_node_voltages(os.path.join(mpi_dir, "dc_op.dat"))
+		if not distributed:
+			print(f"{ranks} ranks: no .PRINT nodes in the output")
+			failed = True
+			continue
+
+		error = max(abs(v - golden[node]) / max(abs(golden[node]), 1e-12) for node, v in distributed.items())
+		print(f"{ranks} ranks: {len(distributed)} nodes, max relative error {error:.3e}")
+		if error > args.tol:
+			failed = True
+
+	sys.exit(1 if failed else 0)
+
+if __name__ == "__main__":
+	main()
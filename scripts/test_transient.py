@@ -0,0 +1,136 @@
+# Script that checks the transient options against the fixed step runs of the circuit files in a directory.
+# For every <test>.cir the outputs of the fixed step TR and BE runs are the references of:
+#   - LTETOL (adaptive TR steps) and GEAR, against TR
+#   - PARAREAL with TR and with BE, against the same method with the fixed step
+#   - the iterative solvers GMRES, BiCGSTAB (non SPD tests) or CG with DEFLATION (tests with SPD in their
+#     name), and SCALE, all with TR, against TR with the direct solver
+#   - the stimulus files <test>_scenario_<i>.stim of the directory, run together with --scenarios, against TR
+#     on a copy of the netlist whose source lines are replaced by the ones of the file
+# A netlist whose .TRAN step is larger than --max_step is run from a copy with the step limited, since the fixed
+# step references of an under resolved waveform differ from the adaptive and GEAR runs by more than the tolerance.
+# The transient outputs are compared with compare_transient.py and the script exits with 1 if a check fails.
+# Usage: python3 test_transient.py tests/course_transient/ [OPTIONS]
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+script_dir = os.path.dirname(os.path.abspath(__file__))
+
+def run_spic(spic, cir_file, output_dir, spic_args):
+	result = subprocess.run([spic, "--cir_file", cir_file, "--output_dir", output_dir, "--bypass_options"] + spic_args,
+							stdout=subprocess.DEVNULL)
+	if result.returncode != 0:
+		raise RuntimeError(f"spic execution failed for cir_file {cir_file} with {' '.join(spic_args)}")
+
+def compare(reference_dir, output_dir, tol, compare_args=[]):
+	result = subprocess.run(["python3", os.path.join(script_dir, "compare_transient.py"), reference_dir, output_dir,
+							 "--tol", str(tol)] + compare_args, stdout=subprocess.PIPE, text=True)
+	return result.returncode == 0, result.stdout.strip().splitlines()[-1]
+
+# Copy of the netlist with the source lines of the stimulus file in place of the ones with the same names
+def apply_scenario(cir_file, stim_file, edited_file):
+	sources = {}
+	with open(stim_file, 'r') as file:
+		for line in file:
+			if line[:1].upper() in ("V", "I"):
+				sources[line.split()[0].upper()] = line
+
+	with open(cir_file, 'r') as file, open(edited_file, 'w') as edited:
+		for line in file:
+			fields = line.split()
+			if fields and fields[0].upper() in sources:
+				line = sources[fields[0].upper()]
+			edited.write(line)
+
+# Copy of the netlist with the step of its .TRAN card limited to max_step
+def limit_step(cir_file, max_step, edited_file):
+	with open(cir_file, 'r') as file, open(edited_file, 'w') as edited:
+		for line in file:
+			fields = line.split()
+			if fields and fields[0].upper() == ".TRAN" and float(fields[1]) > max_step:
+				line = " ".join([fields[0], str(max_step)] + fields[2:]) + "\n"
+			edited.write(line)
+
+def main():
+	parser = argparse.ArgumentParser(description="Compare the transient options with fixed step runs")
+	parser.add_argument("tests_dir", help="Directory containing the tests")
+	parser.add_argument("--sparse", action='store_true', help="Enable sparse matrix option")
+	parser.add_argument("--tol", type=float, default=1e-3, help="Largest error allowed, relative to the waveform")
+	parser.add_argument("--itol", default="1e-10", help="ITOL of the iterative solver checks")
+	parser.add_argument("--ltetol", default="1e-5", help="LTETOL of the adaptive step check")
+	parser.add_argument("--parareal", default="4", help="Time slices of the Parareal checks")
+	parser.add_argument("--max_step", type=float, default=0.002, help="Largest .TRAN step of the runs")
+	parser.add_argument("--deflation", default="4", help="Vectors of the DEFLATION check of the SPD tests")
+	parser.add_argument("--spic", default=os.path.join(script_dir, "../build/spic"), help="Path to the spic binary")
+	args = parser.parse_args()
+
+	base_args = ["--sparse"] if args.sparse else []
+	iter_args = ["--iter", "--custom", f"--itol={args.itol}"]
+
+	failed = False
+	tests = sorted(os.listdir(args.tests_dir))
+	for test in tests:
+		if not test.endswith(".cir"):
+			continue
+
+		name = test.removesuffix(".cir")
+		cir_file = os.path.join(args.tests_dir, test)
+		output_dir = os.path.join(args.tests_dir, "output", "transient", name)
+		spd = "SPD" in test
+		spd_args = ["--spd"] if spd else []
+		os.makedirs(output_dir, exist_ok=True)
+		limited_file = os.path.join(output_dir, test)
+		limit_step(cir_file, args.max_step, limited_file)
+		cir_file = limited_file
+
+		references = {}
+		for method in ("TR", "BE"):
+			references[method] = os.path.join(output_dir, method)
+			run_spic(args.spic, cir_file, references[method], base_args + spd_args + [f"--transient_method={method}"])
+
+		checks = [
+			("LTETOL", "TR", ["--transient_method=TR", f"--ltetol={args.ltetol}"]),
+			("GEAR", "TR", ["--transient_method=GEAR"]),
+			("PARAREAL_TR", "TR", ["--transient_method=TR", f"--parareal={args.parareal}"]),
+			("PARAREAL_BE", "BE", ["--transient_method=BE", f"--parareal={args.parareal}"]),
+			("SCALE", "TR", ["--transient_method=TR", "--scale"]),
+		]
+		if spd:
+			checks.append(("CG_DEFLATION", "TR", ["--transient_method=TR", f"--deflation={args.deflation}"] + iter_args))
+		else:
+			checks.append(("GMRES", "TR", ["--transient_method=TR", "--gmres"] + iter_args))
+			checks.append(("BICGSTAB", "TR", ["--transient_method=TR", "--bicgstab"] + iter_args))
+
+		for check, method, check_args in checks:
+			check_dir = os.path.join(output_dir, check)
+			run_spic(args.spic, cir_file, check_dir, base_args + spd_args + check_args)
+			ok, summary = compare(references[method], check_dir, args.tol)
+			print(f"{test} {check} against {method}: {summary}")
+			failed = failed or not ok
+
+		# The scenarios are run together and each one is compared with the run on its edited netlist
+		stim_files = sorted((f for f in tests if re.fullmatch(re.escape(name) + r"_scenario_\d+\.stim", f)),
+							key=lambda f: int(re.search(r"_(\d+)\.stim$", f).group(1)))
+		if not stim_files:
+			continue
+
+		scenarios_dir = os.path.join(output_dir, "SCENARIOS")
+		run_spic(args.spic, cir_file, scenarios_dir, base_args + spd_args + ["--transient_method=TR", "--scenarios"]
+				 + [os.path.join(args.tests_dir, f) for f in stim_files])
+		for i, stim_file in enumerate(stim_files, start=1):
+			edited_file = os.path.join(output_dir, f"{name}_scenario_{i}.cir")
+			apply_scenario(cir_file, os.path.join(args.tests_dir, stim_file), edited_file)
+			edited_dir = os.path.join(output_dir, f"TR_scenario_{i}")
+			run_spic(args.spic, edited_file, edited_dir, base_args + spd_args + ["--transient_method=TR"])
+
+			ok, summary = compare(edited_dir, scenarios_dir, args.tol, ["--scenario", str(i)])
+			print(f"{test} {stim_file} against TR: {summary}")
+			failed = failed or not ok
+
+	sys.exit(1 if failed else 0)
+
+if __name__ == "__main__":
+	main()
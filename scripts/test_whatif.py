@@ -0,0 +1,76 @@
+# Script that checks the What-If variants of the circuit files in a directory against runs on edited netlists.
+# For every <test>.cir with .WHATIF lines the directory holds <test>_whatif_<i>.cir, the netlist with the changes
+# of the i-th variant applied. The operating point of whatif/whatif_<i>.dat of the first run is compared with
+# the dc_op.dat of the run on the edited netlist, and the script exits with 1 if a node differs by more than --tol.
+# Usage: python3 test_whatif.py tests/whatif/ [OPTIONS]
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+# Node voltages of an operating point file, the source currents that dc_op.dat has after them are skipped
+def read_node_voltages(file_path):
+	voltages = {}
+	with open(file_path, 'r') as file:
+		for line in file:
+			if line.startswith("Source Current"):
+				break
+			if line.isspace() or line.startswith("Node Voltage"):
+				continue
+			node_name, voltage = line.split()
+			voltages[node_name] = float(voltage)
+	return voltages
+
+def run_spic(spic, cir_file, output_dir, spic_args):
+	result = subprocess.run([spic, "--cir_file", cir_file, "--output_dir", output_dir, "--bypass_options"] + spic_args,
+							stdout=subprocess.DEVNULL)
+	if result.returncode != 0:
+		raise RuntimeError(f"spic execution failed for cir_file {cir_file}")
+
+def main():
+	parser = argparse.ArgumentParser(description="Compare the What-If variants with runs on the edited netlists")
+	parser.add_argument("tests_dir", help="Directory containing the tests")
+	parser.add_argument("--custom", action='store_true', help="Enable custom solver option")
+	parser.add_argument("--sparse", action='store_true', help="Enable sparse matrix option")
+	parser.add_argument("--tol", type=float, default=1e-6, help="Largest relative error allowed")
+	parser.add_argument("--spic", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "../build/spic"),
+						help="Path to the spic binary")
+	args = parser.parse_args()
+
+	spic_args = []
+	if args.custom:
+		spic_args.append("--custom")
+	if args.sparse:
+		spic_args.append("--sparse")
+
+	failed = False
+	tests = sorted(os.listdir(args.tests_dir))
+	for test in tests:
+		if not test.endswith(".cir") or "_whatif_" in test:
+			continue
+
+		name = test.removesuffix(".cir")
+		output_dir = os.path.join(args.tests_dir, "output", name + "_output")
+		run_spic(args.spic, os.path.join(args.tests_dir, test), output_dir, spic_args)
+
+		for edited in tests:
+			match = re.fullmatch(re.escape(name) + r"_whatif_(\d+)\.cir", edited)
+			if not match:
+				continue
+
+			edited_dir = os.path.join(args.tests_dir, "output", edited.removesuffix(".cir") + "_output")
+			run_spic(args.spic, os.path.join(args.tests_dir, edited), edited_dir, spic_args)
+
+			whatif = read_node_voltages(os.path.join(output_dir, "whatif", f"whatif_{match.group(1)}.dat"))
+			golden = read_node_voltages(os.path.join(edited_dir, "dc_op.dat"))
+			error = max(abs(v - golden[node]) / max(abs(golden[node]), 1e-12) for node, v in whatif.items())
+			print(f"{test} variant {match.group(1)}: max relative error {error:.3e}")
+			if error > args.tol:
+				failed = True
+
+	sys.exit(1 if failed else 0)
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,326 @@
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <cmath>
+#include <bit>
+
+#include <omp.h>
+
+#include "autotuner.h"
+#include "commands.h"
+#include "netlist.h"
+#include "node_table.h"
+#include "system.h"
+#include "sparse_system.h"
+
+namespace spic {
+	/* Select the fastest solver options that meet ITOL for the MNA system of the deck.
+	 * The decision is cached by the matrix and the options that affect it, so later runs
+	 * of the same circuit skip the trials.
+	 */
+	void Autotuner::tune(std::filesystem::path cache_file)
+	{
+		logger.log(INFO, "Autotuning the solver options.");
+
+		// The sparse system is cheap to build for every size, so the matrix is inspected on it
+		MNASparseSystem sparse_system(netlist, node_table.size());
+		const Eigen::SparseMatrix<double> A = sparse_system.A;
+		const Eigen::VectorXd b = sparse_system.b;
+		uint64_t signature = get_signature(A);
+
+		if (load_decision(cache_file, signature)) {
+			logger.log(INFO, "Using the cached decision " + get_method_name(options)
+							 + " from " + cache_file.string());
+			return;
+		}
+
+		bool symmetric = is_symmetric(A);
+		bool dominant = is_diagonally_dominant(A);
+		bool dense = (sparse_system.n <= AUTOTUNE_MAX_DENSE);
+
+		std::stringstream ss;
+		ss << "Matrix of size " << sparse_system.n << " with " << A.nonZeros() << " non zeros, "
+		   << (symmetric ? "symmetric" : "non symmetric") << ", "
+		   << (dominant ? "diagonally dominant" : "not diagonally dominant");
+		logger.log(INFO, ss.str());
+
+		// A symmetric diagonally dominant matrix with a positive diagonal is SPD, so the
+		// Cholesky candidates can not abort the trials on a failed decomposition
+		std::vector<candidate_t> candidates = get_candidates(symmetric && dominant, dense);
+
+		MNASystem *system = (dense) ? new MNASystem(netlist, node_table.size()) : nullptr;
+
+		candidate_t *best = nullptr;
+		for (auto &candidate : candidates) {
+			trial(candidate, system, sparse_system, A, b);
+
+			ss.str("");
+			ss << "Trial " << get_method_name(candidate.options) << ": estimated "
+			   << candidate.secs << " secs, residual " << candidate.residual;
+			logger.log(INFO, ss.str());
+
+			// Comparisons with a NaN residual are false, so diverged trials are rejected too
+			if (!(candidate.residual <= options.itol)) {
+				continue;
+			}
+			if (best == nullptr || candidate.secs < best->secs) {
+				best = &candidate;
+			}
+		}
+
+		delete system;
+
+		if (best == nullptr) {
+			logger.log(WARNING, "No candidate met ITOL, keeping the given solver options");
+			return;
+		}
+
+		options = best->options;
+		logger.log(INFO, "Autotuner selected " + get_method_name(options));
+		store_decision(cache_file, signature);
+	}
+
+	/* FNV-1a hash of the dimension, the sparsity pattern and the values of A, together with
+	 * everything else the decision depends on: ITOL, the expected solves, and the options
+	 * that restrict the candidates
+	 */
+	uint64_t Autotuner::get_signature(const Eigen::SparseMatrix<double> &A)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		auto mix = [&hash](int64_t value) {
+			for (int i = 0; i < 8; i++) {
+				hash ^= (value >> (8 * i)) & 0xff;
+				hash *= 1099511628211ULL;
+			}
+		};
+
+		mix(A.rows());
+		mix(A.nonZeros());
+		for (int k = 0; k < A.outerSize(); k++) {
+			for (Eigen::SparseMatrix<double>::InnerIterator it(A, k); it; ++it) {
+				mix(it.row());
+				mix(it.col());
+				mix(std::bit_cast<int64_t>(it.value()));
+			}
+		}
+
+		mix(std::bit_cast<int64_t>(options.itol));
+		mix(expected_solves());
+		mix(options.domains > 1);
+		mix(options.ooc > 0);
+		return hash;
+	}
+
+	bool Autotuner::is_symmetric(const Eigen::SparseMatrix<double> &A)
+	{
+		Eigen::SparseMatrix<double> At = A.transpose();
+		double norm = A.norm();
+		return (norm == 0) || ((A - At).norm() <= 1e-12 * norm);
+	}
+
+	/* Every row has a positive diagonal that is not smaller than the sum of its off diagonal terms */
+	bool Autotuner::is_diagonally_dominant(const Eigen::SparseMatrix<double> &A)
+	{
+		Eigen::VectorXd diagonal = Eigen::VectorXd::Zero(A.rows());
+		Eigen::VectorXd off_diagonal = Eigen::VectorXd::Zero(A.rows());
+
+		for (int k = 0; k < A.outerSize(); k++) {
+			for (Eigen::SparseMatrix<double>::InnerIterator it(A, k); it; ++it) {
+				if (it.row() == it.col()) {
+					diagonal[it.row()] += it.value();
+				} else {
+					off_diagonal[it.row()] += std::abs(it.value());
+				}
+			}
+		}
+
+		for (int i = 0; i < A.rows(); i++) {
+			if (diagonal[i] <= 0 || diagonal[i] < off_diagonal[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/* Number of solves the analyses of the deck will do with one factorization */
+	int Autotuner::expected_solves()
+	{
+		int solves = 1; // Operating point
+
+		for (auto &tran : commands.transient_list) {
+			solves += std::ceil(tran.fin_time / tran.time_step);
+		}
+		for (auto &sweep : commands.v_dc_sweeps) {
+			solves += std::floor((sweep.end_value - sweep.start_value) / sweep.step) + 1;
+		}
+		for (auto &sweep : commands.i_dc_sweeps) {
+			solves += std::floor((sweep.end_value - sweep.start_value) / sweep.step) + 1;
+		}
+		return solves;
+	}
+
+	std::vector<Autotuner::candidate_t> Autotuner::get_candidates(bool spd, bool dense)
+	{
+		std::vector<candidate_t> candidates;
+
+		auto add = [&](bool sparse, bool iter, bool spd, bool custom, bool gmres, bool bicgstab) {
+			// DOMAINS and OOC are kept from the given options, so only the methods that implement them are tried
+			if (options.domains > 1 && !(sparse && !iter && !custom)) {
+				return;
+			}
+			if (options.ooc > 0 && !(sparse && spd && !iter && !custom && options.domains <= 1)) {
+				return;
+			}
+
+			candidate_t candidate;
+			candidate.options = options;
+			candidate.options.sparse = sparse;
+			candidate.options.iter = iter;
+			candidate.options.spd = spd;
+			candidate.options.custom = custom;
+			candidate.options.gmres = gmres;
+			candidate.options.bicgstab = bicgstab;
+			candidate.options.mixed = false;
+			candidate.options.deflation = 0;
+			candidate.secs = std::numeric_limits<double>::infinity();
+			candidate.residual = std::numeric_limits<double>::quiet_NaN();
+			candidates.push_back(candidate);
+		};
+
+		// Sparse candidates, the custom direct methods only support dense systems
+		add(true, false, false, false, false, false); // LU
+		add(true, true, false, false, false, false);  // BiCG
+		add(true, true, false, true, false, false);
+		add(true, true, false, true, true, false);    // GMRES
+		add(true, true, false, true, false, true);    // BiCGSTAB
+		if (spd) {
+			add(true, false, true, false, false, false); // Cholesky
+			add(true, true, true, false, false, false);  // CG
+			add(true, true, true, true, false, false);
+		}
+
+		// Dense candidates
+		if (dense) {
+			add(false, false, false, false, false, false); // LU
+			add(false, false, false, true, false, false);
+			add(false, true, false, false, false, false);  // BiCG
+			add(false, true, false, true, false, false);
+			if (spd) {
+				add(false, false, true, false, false, false); // Cholesky
+				add(false, false, true, true, false, false);
+				add(false, true, true, false, false, false);  // CG
+				add(false, true, true, true, false, false);
+			}
+		}
+
+		return candidates;
+	}
+
+	/* Time one analyze() and AUTOTUNE_TRIAL_SOLVES solves of the candidate from a zero initial guess */
+	void Autotuner::trial(candidate_t &candidate, MNASystem *system, MNASparseSystem &sparse_system,
+						const Eigen::SparseMatrix<double> &A, const Eigen::VectorXd &b)
+	{
+		options_t &trial_options = candidate.options;
+		Eigen::VectorXd *x;
+		Solver *solver;
+
+		// The dense direct methods factor A in place, so every trial starts from the original matrix
+		if (trial_options.sparse) {
+			sparse_system.A = A;
+			x = &sparse_system.x;
+			solver = new Solver(sparse_system, trial_options, logger);
+		} else {
+			system->A = Eigen::MatrixXd(A);
+			x = &system->x;
+			solver = new Solver(*system, trial_options, logger);
+		}
+
+		double start = omp_get_wtime();
+		solver->analyze();
+		double secs_in_analyze = omp_get_wtime() - start;
+
+		start = omp_get_wtime();
+		for (int i = 0; i < AUTOTUNE_TRIAL_SOLVES; i++) {
+			x->setZero();
+			solver->solve(b);
+		}
+		double secs_per_solve = (omp_get_wtime() - start) / AUTOTUNE_TRIAL_SOLVES;
+
+		candidate.secs = secs_in_analyze + expected_solves() * secs_per_solve;
+
+		double b_norm = b.norm();
+		double r_norm = (A * (*x) - b).norm();
+		candidate.residual = (b_norm > 0) ? r_norm / b_norm : r_norm;
+
+		delete solver;
+	}
+
+	std::string Autotuner::get_method_name(const options_t &trial_options)
+	{
+		std::string name = std::string(trial_options.sparse ? "sparse " : "dense ")
+						 + std::string(trial_options.custom ? "custom " : "integrated ");
+
+		if (trial_options.iter) {
+			if (trial_options.gmres) {
+				name += "GMRES";
+			} else if (trial_options.bicgstab) {
+				name += "BiCGSTAB";
+			} else {
+				name += (trial_options.spd) ? "CG" : "BiCG";
+			}
+		} else {
+			name += (trial_options.spd) ? "Cholesky" : "LU";
+		}
+		return name;
+	}
+
+	/* Cache lines are: <signature> <sparse> <iter> <spd> <custom> <gmres> <bicgstab> */
+	bool Autotuner::load_decision(std::filesystem::path cache_file, uint64_t signature)
+	{
+		std::ifstream file(cache_file);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(file, line)) {
+			std::istringstream iss(line);
+			uint64_t cached_signature;
+			bool sparse, iter, spd, custom, gmres, bicgstab;
+
+			if (!(iss >> std::hex >> cached_signature >> std::dec
+					  >> sparse >> iter >> spd >> custom >> gmres >> bicgstab)) {
+				continue;
+			}
+			if (cached_signature != signature) {
+				continue;
+			}
+
+			options.sparse = sparse;
+			options.iter = iter;
+			options.spd = spd;
+			options.custom = custom;
+			options.gmres = gmres;
+			options.bicgstab = bicgstab;
+			options.mixed = false;
+			options.deflation = 0;
+			return true;
+		}
+		return false;
+	}
+
+	void Autotuner::store_decision(std::filesystem::path cache_file, uint64_t signature)
+	{
+		std::ofstream file(cache_file, std::ios::app);
+		if (!file.is_open()) {
+			logger.log(WARNING, "Unable to open file for writing: " + cache_file.string());
+			return;
+		}
+
+		file << std::hex << signature << std::dec << " "
+			 << options.sparse << " " << options.iter << " " << options.spd << " "
+			 << options.custom << " " << options.gmres << " " << options.bicgstab << std::endl;
+		file.close();
+	}
+}
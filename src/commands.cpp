@@ -4,6 +4,9 @@
 #include <filesystem>
 #include <cstdio>
 #include <set>
+#include <algorithm>
+#include <unistd.h>
+#include <omp.h>
 
 #include "commands.h"
 #include "solver.h"
@@ -54,6 +57,35 @@ namespace spic {
 		}
 	}
 
+	// Commands::transient_jobs function finds how many Transient Analysises run concurrently: at most TRANJOBS,
+	// and only as many as fit in TRAN_JOBS_MEMORY_FRACTION of the available memory, as each one keeps
+	// its own system (of analysis_bytes with its factorization) and the results of its print nodes
+	int Commands::transient_jobs(long analysis_bytes, Logger &logger)
+	{
+		int jobs = std::min<int>(options.tran_jobs, transient_list.size());
+		if (jobs <= 1) {
+			return 1;
+		}
+
+		long outputs = 0;
+		for (auto &t : transient_list) {
+			outputs = std::max(outputs, (long)(t.fin_time / t.time_step) + 1);
+		}
+		analysis_bytes += outputs * (print_nodes.size() + plot_nodes.size() + 1) * sizeof(double);
+
+		long available = sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+		int fit = std::max<long>(1, TRAN_JOBS_MEMORY_FRACTION * available / analysis_bytes);
+		if (fit < jobs) {
+			logger.log(WARNING, "Only " + std::to_string(fit) + " of " + std::to_string(jobs)
+								+ " concurrent Transient Analysises fit in the available memory");
+			jobs = fit;
+		}
+		if (jobs > 1 && options.fact_cache > 0) {
+			logger.log(WARNING, "The factorization cache is not used by concurrent Transient Analysises");
+		}
+		return jobs;
+	}
+
 	// Commands::perform_dc_sweeps function performs all the Transient Analysises
 	void Commands::perform_transients(Solver &solver, MNASystem &mna_system, Logger &logger)
 	{
@@ -66,11 +98,47 @@ namespace spic {
 
 		MNASystemTransient tran_mna_system(commands.options.transient_method, mna_system);
 
-		// Perform the Transient Analysises
-		for (auto &t : transient_list) {
-			t.load_system(&tran_mna_system);
-			t.run(solver, print_nodes, plot_nodes, transient_dir, logger);
+		// A and its factorization are dense, the iterative methods keep only a preconditioner
+		long n = mna_system.n;
+		int jobs = transient_jobs(n * n * sizeof(double) * (options.iter ? 1 : 2) + 16 * n * sizeof(double), logger);
+
+		if (jobs <= 1) {
+			if (options.fact_cache > 0) {
+				factorization_cache = std::make_unique<FactorizationCache>(solver, tran_mna_system.G_ptr, tran_mna_system.C_ptr,
+																		   (long)options.fact_cache << 20);
+			}
+
+			// Perform the Transient Analysises
+			for (auto &t : transient_list) {
+				t.load_system(&tran_mna_system);
+				t.load_cache(factorization_cache.get());
+				t.run(solver, print_nodes, plot_nodes, transient_dir, logger);
+			}
+			return;
 		}
+
+		// Every Transient Analysis runs on its own system and solver, sharing G and C, and its solver
+		// runs on an equal share of the threads in a nested region. The factorizations are not cached across them.
+		int threads = std::max(1, omp_get_max_threads() / jobs);
+		int levels = omp_get_max_active_levels();
+		omp_set_max_active_levels(2);
+		logger.log(INFO, "Running " + std::to_string(jobs) + " Transient Analysises concurrently on "
+							+ std::to_string(threads) + " threads each");
+		#pragma omp parallel for num_threads(jobs) schedule(dynamic)
+		for (int i = 0; i < transient_list.size(); i++) {
+			omp_set_num_threads(threads);
+
+			MNASystem system(mna_system);
+			MNASystemTransient tran_system(tran_mna_system, system);
+			Solver tran_solver(system, options, logger);
+
+			transient_list[i].load_system(&tran_system);
+			transient_list[i].run(tran_solver, print_nodes, plot_nodes, transient_dir, logger);
+
+			#pragma omp critical
+			solver.add_perf_counters(tran_solver);
+		}
+		omp_set_max_active_levels(levels);
 	}
 
 	// Commands::perform_dc_sweeps function performs all the Transient Analysises
@@ -86,10 +154,69 @@ namespace spic {
 
 		MNASparseSystemTransient tran_mna_sparse_system(commands.options.transient_method, mna_sparse_system);
 
-		// Perform the Transient Analysises
-		for (auto &t : transient_list) {
-			t.load_system(&tran_mna_sparse_system);
-			t.run(solver, print_nodes, plot_nodes, transient_dir, logger);
+		// A = G + alpha * C, its factorization is assumed to fill it by TRAN_FILL_ESTIMATE
+		// and the iterative methods keep a row-major copy of it
+		long n = mna_sparse_system.n;
+		long matrix_bytes = (tran_mna_sparse_system.G.nonZeros() + tran_mna_sparse_system.C.nonZeros())
+							* (sizeof(double) + sizeof(int));
+		int jobs = transient_jobs(matrix_bytes * (options.iter ? 2 : 1 + TRAN_FILL_ESTIMATE) + 16 * n * sizeof(double), logger);
+
+		if (jobs <= 1) {
+			if (options.fact_cache > 0) {
+				factorization_cache = std::make_unique<FactorizationCache>(solver, tran_mna_sparse_system.G_ptr,
+																		   tran_mna_sparse_system.C_ptr,
+																		   (long)options.fact_cache << 20);
+			}
+
+			// Perform the Transient Analysises
+			for (auto &t : transient_list) {
+				t.load_system(&tran_mna_sparse_system);
+				t.load_cache(factorization_cache.get());
+				t.run(solver, print_nodes, plot_nodes, transient_dir, logger);
+			}
+			return;
+		}
+
+		// Every Transient Analysis runs on its own system and solver, sharing G and C, and its solver
+		// runs on an equal share of the threads in a nested region. The factorizations are not cached across them.
+		int threads = std::max(1, omp_get_max_threads() / jobs);
+		int levels = omp_get_max_active_levels();
+		omp_set_max_active_levels(2);
+		logger.log(INFO, "Running " + std::to_string(jobs) + " Transient Analysises concurrently on "
+							+ std::to_string(threads) + " threads each");
+		#pragma omp parallel for num_threads(jobs) schedule(dynamic)
+		for (int i = 0; i < transient_list.size(); i++) {
+			omp_set_num_threads(threads);
+
+			MNASparseSystem sparse_system(mna_sparse_system);
+			MNASparseSystemTransient tran_sparse_system(tran_mna_sparse_system, sparse_system);
+			Solver tran_solver(sparse_system, options, logger);
+
+			transient_list[i].load_system(&tran_sparse_system);
+			transient_list[i].run(tran_solver, print_nodes, plot_nodes, transient_dir, logger);
+
+			#pragma omp critical
+			solver.add_perf_counters(tran_solver);
+		}
+		omp_set_max_active_levels(levels);
+	}
+
+	// Commands::perform_whatifs function solves the What-If variants with the factorization of the DC system
+	void Commands::perform_whatifs(Solver *solver, Logger &logger)
+	{
+		logger.log(INFO, "Performing What-If Variants");
+
+		logger.log(INFO, "Creating " + std::string(whatif_dir));
+		if (!std::filesystem::create_directories(whatif_dir)) {
+			logger.log(ERROR, "Unable to create " + std::string(whatif_dir));
+		}
+
+		const Eigen::VectorXd &b = (solver->options.sparse) ? solver->sparse_system->b : solver->system->b;
+		Eigen::VectorXd x;
+
+		for (int i = 0; i < whatifs.size(); i++) {
+			whatifs[i].solve(solver, b, x);
+			whatifs[i].dump_results(x, whatif_dir/("whatif_" + std::to_string(i + 1) + ".dat"));
 		}
 	}
 }
@@ -109,6 +236,14 @@ std::ostream& operator<<(std::ostream &out, const spic::Commands &commands) {
 		out << commands.transient_list;
 	}
 
+	if (!commands.scenarios.empty()) {
+		out << commands.scenarios;
+	}
+
+	if (!commands.whatifs.empty()) {
+		out << commands.whatifs;
+	}
+
 	if (!commands.print_nodes.empty()) {
 		out << "\tPrint Nodes:\n";
 		for (const auto &node : commands.print_nodes) {
@@ -37,7 +37,8 @@ namespace spic {
 						std::filesystem::path    dc_sweeps_dir)
 	{
 		Eigen::VectorXd &x = (solver->options.sparse) ? solver->sparse_system->x : solver->system->x;
-		Eigen::VectorXd b_new = (solver->options.sparse) ? solver->sparse_system->b : solver->system->b;
+		Eigen::VectorXd b_base = (solver->options.sparse) ? solver->sparse_system->b : solver->system->b;
+		Eigen::VectorXd b_unit = Eigen::VectorXd::Zero(b_base.size());
 
 		int voltage_src_id, matrix_src_id, current_src_id, current_pos_node, current_neg_node;
 		double current_src_value;
@@ -49,42 +50,40 @@ namespace spic {
 		// Convert the set back to a vector
 		std::vector<std::string> unique_vector(unique_elements.begin(), unique_elements.end());
 
-		// Create updated version of b with the DC Sweep initial parameters
+		// Split b into the rest of the circuit (b_base) and the stamp of a unit swept source (b_unit)
+		// so that the b of each sweep point is b_base + src_value * b_unit
 		if (type == V) {
 			voltage_src_id = netlist.voltage_sources.find_element_name(source_name);
 			matrix_src_id = (node_table.size()-1) + voltage_src_id;
-			b_new(matrix_src_id) = start_value;
+			b_base(matrix_src_id) = 0;
+			b_unit(matrix_src_id) = 1;
 		} else { // type == I
 			current_src_id = netlist.current_sources.find_element_name(source_name);
 			current_pos_node = netlist.current_sources.elements[current_src_id].node_positive;
 			current_neg_node = netlist.current_sources.elements[current_src_id].node_negative;
 			current_src_value = netlist.current_sources.elements[current_src_id].value;
 
-			// Remove old current source stamp from b_new
+			// Remove old current source stamp from b_base and add a unit stamp to b_unit
 			if (current_pos_node > 0) {
-				b_new(current_pos_node - 1) += current_src_value;
+				b_base(current_pos_node - 1) += current_src_value;
+				b_unit(current_pos_node - 1) -= 1;
 			}
 			if (current_neg_node > 0) {
-				b_new(current_neg_node - 1) -= current_src_value;
-			}
-
-			// Add new current source stamp to b_new
-			if (current_pos_node > 0) {
-				b_new(current_pos_node - 1) -= start_value;
-			}
-			if (current_neg_node > 0) {
-				b_new(current_neg_node - 1) += start_value;
+				b_base(current_neg_node - 1) -= current_src_value;
+				b_unit(current_neg_node - 1) += 1;
 			}
 		}
 
 		// Init vector of vectors
 		std::unordered_map<std::string, std::vector<double>> dc_sweep_data;
+		std::vector<int> node_ids;
 		for (auto &print_node : unique_vector) {
 			dc_sweep_data[print_node] = std::vector<double>();
+			node_ids.push_back(node_table.find_node(&print_node) - 1);
 		}
 		std::vector<double> dc_sweep_src;
 
-		// Produce the DC Sweep results for all print nodes
+		// Produce the source values of all the DC Sweep points
 		double src_value = start_value;
 
 		const auto relative_difference_factor = 0.0001;    // 0.01%
@@ -92,27 +91,58 @@ namespace spic {
 		const auto tolerance = greater_magnitude * relative_difference_factor;
 
 		while (src_value < end_value || std::abs(src_value - end_value) < tolerance) {
-			// Store the source value for the current iteration
 			dc_sweep_src.push_back(src_value);
+			src_value += step;
+		}
 
-			solver->solve(b_new);
-			for (auto &print_node : unique_vector) {
-				int node_id = node_table.find_node(&print_node) - 1;
-				dc_sweep_data[print_node].push_back(x(node_id));
+		// A sweep without points (e.g. start > end) has nothing to interpolate from, the fallback
+		// below then solves nothing and the sweep files are written empty
+		if (netlist.is_linear() && !dc_sweep_src.empty()) {
+			// The circuit is linear so every node voltage is an affine function of the source value,
+			// thus solving for the first and the last sweep point is enough for the whole sweep
+			solver->logger.log(INFO, "DC Sweep: circuit is linear, using superposition.");
+			int nodes = node_ids.size();
+			double first_value = dc_sweep_src.front();
+			double last_value = dc_sweep_src.back();
+
+			Eigen::MatrixXd B(b_base.size(), 2);
+			Eigen::MatrixXd X(b_base.size(), 2);
+			B << b_base + first_value * b_unit, b_base + last_value * b_unit;
+			X << x, x;
+			solver->solve(B, X);
+
+			// Response of the probed nodes to a unit change of the source
+			Eigen::VectorXd x_first(nodes), x_slope(nodes);
+			for (int i = 0; i < nodes; i++) {
+				x_first(i) = X(node_ids[i], 0);
+				x_slope(i) = (last_value != first_value) ?
+								(X(node_ids[i], 1) - X(node_ids[i], 0)) / (last_value - first_value) : 0;
 			}
 
-			// Update the source value for the next iteration
-			if (type == V) {
-				b_new(matrix_src_id) += step;
-			} else { // type == I
-				if (current_pos_node > 0) {
-					b_new(current_pos_node - 1) -= step;
+			for (auto value : dc_sweep_src) {
+				for (int i = 0; i < nodes; i++) {
+					dc_sweep_data[unique_vector[i]].push_back(x_first(i) + (value - first_value) * x_slope(i));
 				}
-				if (current_neg_node > 0) {
-					b_new(current_neg_node - 1) += step;
+			}
+		} else {
+			// Fallback for non-linear circuits: solve the sweep points in blocks of right-hand sides
+			int points = dc_sweep_src.size();
+			for (int first = 0; first < points; first += DC_SWEEP_BLOCK_SIZE) {
+				int width = std::min(DC_SWEEP_BLOCK_SIZE, points - first);
+				Eigen::MatrixXd B(b_base.size(), width);
+				Eigen::MatrixXd X(b_base.size(), width);
+				for (int j = 0; j < width; j++) {
+					B.col(j) = b_base + dc_sweep_src[first + j] * b_unit;
+					X.col(j) = x;
+				}
+
+				solver->solve(B, X);
+				for (int i = 0; i < node_ids.size(); i++) {
+					for (int j = 0; j < width; j++) {
+						dc_sweep_data[unique_vector[i]].push_back(X(node_ids[i], j));
+					}
 				}
 			}
-			src_value += step;
 		}
 
 		// Write the DC Sweep results to files
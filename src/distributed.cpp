@@ -0,0 +1,429 @@
+#ifdef SPIC_MPI
+
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <algorithm>
+
+#include "distributed.h"
+#include "node_table.h"
+
+namespace spic {
+	DistributedSolver::DistributedSolver(Netlist &netlist, int total_nodes, options_t &options, Logger &logger)
+		: total_nodes(total_nodes), options(options), logger(logger)
+	{
+		double start = MPI_Wtime();
+
+		MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+		MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+		// Only rank 0 has parsed the circuit
+		int total_branches = netlist.voltage_sources.size() + netlist.inductors.size();
+		MPI_Bcast(&this->total_nodes, 1, MPI_INT, 0, MPI_COMM_WORLD);
+		MPI_Bcast(&total_branches, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+		// Split the rows in contiguous blocks of equal size
+		n = this->total_nodes - 1 + total_branches;
+		row_starts.resize(size + 1);
+		for (int r = 0; r <= size; r++) {
+			row_starts[r] = (long)n * r / size;
+		}
+		row_begin = row_starts[rank];
+		row_end = row_starts[rank + 1];
+
+		// Only the elements of the owned rows reach this rank, and only the owned rows of A and b are stamped
+		std::vector<stamp_element_t> resistors, current_sources, branches;
+		distribute_elements(netlist, resistors, current_sources, branches);
+
+		std::vector<Eigen::Triplet<double>> triplets;
+		b = Eigen::VectorXd::Zero(row_end - row_begin);
+		x = Eigen::VectorXd::Zero(row_end - row_begin);
+		stamp_rows(resistors, current_sources, branches, triplets);
+
+		setup_halo(triplets);
+
+		// Jacobi preconditioner of the owned rows
+		inv_precond.resize(row_end - row_begin);
+		for (int i = 0; i < row_end - row_begin; i++) {
+			double diagonal = A.coeff(i, i);
+			inv_precond(i) = (std::abs(diagonal) > EPS) ? 1.0 / diagonal : 1.0;
+		}
+
+		perf_counter.secs_in_assembly = MPI_Wtime() - start;
+		perf_counter.secs_in_solve = 0;
+		perf_counter.halo_exchanges = 0;
+
+		logger.log(INFO, "DistributedSolver(): " + std::to_string(size) + " ranks, rank 0 owns "
+						 + std::to_string(row_end - row_begin) + " rows and "
+						 + std::to_string(ghosts.size()) + " ghost entries.");
+	}
+
+	/* Rank that owns a row of the MNA system */
+	int DistributedSolver::owner(int row)
+	{
+		return std::upper_bound(row_starts.begin(), row_starts.end(), row) - row_starts.begin() - 1;
+	}
+
+	/* Rank 0 streams to every rank, in messages of up to DISTRIBUTE_CHUNK elements, the resistors, the
+	 * current sources and the branches (voltage sources and inductors) that stamp one of its rows.
+	 * An element on the rows of two ranks is sent to both, and no other rank holds more of the netlist.
+	 * The resistors of a spooled netlist are read from its spool file instead of from memory.
+	 */
+	void DistributedSolver::distribute_elements(Netlist &netlist, std::vector<stamp_element_t> &resistors,
+												std::vector<stamp_element_t> &current_sources,
+												std::vector<stamp_element_t> &branches)
+	{
+		enum {RESISTORS, CURRENT_SOURCES, BRANCHES, END};
+		std::vector<stamp_element_t> *lists[] = {&resistors, &current_sources, &branches};
+
+		MPI_Datatype element_type;
+		MPI_Type_contiguous(sizeof(stamp_element_t), MPI_BYTE, &element_type);
+		MPI_Type_commit(&element_type);
+
+		if (rank != 0) {
+			MPI_Status status;
+			int count;
+
+			MPI_Probe(0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+			while (status.MPI_TAG != END) {
+				std::vector<stamp_element_t> &list = *lists[status.MPI_TAG];
+				MPI_Get_count(&status, element_type, &count);
+				list.resize(list.size() + count);
+				MPI_Recv(list.data() + list.size() - count, count, element_type, 0, status.MPI_TAG,
+						 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+				MPI_Probe(0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+			}
+			MPI_Recv(nullptr, 0, element_type, 0, END, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+			MPI_Type_free(&element_type);
+			return;
+		}
+
+		// Elements of every list not sent to every rank yet
+		std::vector<std::vector<std::vector<stamp_element_t>>> pending(END, std::vector<std::vector<stamp_element_t>>(size));
+
+		auto send = [&](int list, int r) {
+			MPI_Send(pending[list][r].data(), pending[list][r].size(), element_type, r, list, MPI_COMM_WORLD);
+			pending[list][r].clear();
+		};
+
+		// Send the element to the owners of its rows (negative rows are the ground)
+		auto add = [&](int list, const stamp_element_t &element, std::initializer_list<int> rows) {
+			int owners[3], count = 0;
+			for (int row : rows) {
+				if (row < 0) {
+					continue;
+				}
+				int r = owner(row);
+				if (std::find(owners, owners + count, r) != owners + count) {
+					continue;
+				}
+				owners[count++] = r;
+
+				if (r == 0) {
+					lists[list]->push_back(element);
+				} else {
+					pending[list][r].push_back(element);
+					if (pending[list][r].size() == DISTRIBUTE_CHUNK) {
+						send(list, r);
+					}
+				}
+			}
+		};
+
+		for (auto &resistor : netlist.resistors.elements) {
+			add(RESISTORS, {0, resistor.node_positive, resistor.node_negative, resistor.value},
+				{resistor.node_positive - 1, resistor.node_negative - 1});
+		}
+		// The resistors of a spooled netlist are read back in chunks, so rank 0 never holds all of them
+		if (netlist.spool) {
+			std::vector<spooled_resistor_t> chunk(DISTRIBUTE_CHUNK);
+			size_t count;
+			std::rewind(netlist.spool);
+			while ((count = std::fread(chunk.data(), sizeof(spooled_resistor_t), chunk.size(), netlist.spool)) > 0) {
+				for (size_t k = 0; k < count; k++) {
+					add(RESISTORS, {0, chunk[k].node_positive, chunk[k].node_negative, chunk[k].value},
+						{chunk[k].node_positive - 1, chunk[k].node_negative - 1});
+				}
+			}
+		}
+		for (auto &source : netlist.current_sources.elements) {
+			add(CURRENT_SOURCES, {0, source.node_positive, source.node_negative, source.value},
+				{source.node_positive - 1, source.node_negative - 1});
+		}
+		int total_voltage_sources = netlist.voltage_sources.size();
+		for (int i = 0; i < total_voltage_sources; i++) {
+			auto &source = netlist.voltage_sources.elements[i];
+			add(BRANCHES, {i, source.node_positive, source.node_negative, source.value},
+				{source.node_positive - 1, source.node_negative - 1, total_nodes - 1 + i});
+		}
+		// In DC analysis the inductors are voltage sources with 0 value
+		for (int i = 0; i < netlist.inductors.size(); i++) {
+			auto &inductor = netlist.inductors.elements[i];
+			int id = total_voltage_sources + i;
+			add(BRANCHES, {id, inductor.node_positive, inductor.node_negative, 0},
+				{inductor.node_positive - 1, inductor.node_negative - 1, total_nodes - 1 + id});
+		}
+
+		for (int r = 1; r < size; r++) {
+			for (int list = 0; list < END; list++) {
+				if (!pending[list][r].empty()) {
+					send(list, r);
+				}
+			}
+			MPI_Send(nullptr, 0, element_type, r, END, MPI_COMM_WORLD);
+		}
+		MPI_Type_free(&element_type);
+	}
+
+	/* Stamp the owned rows of A and b with the stamps of the MNA system, the triplets keep
+	 * the global column ids. Every element is stamped as in MNASparseSystem.
+	 */
+	void DistributedSolver::stamp_rows(const std::vector<stamp_element_t> &resistors,
+									   const std::vector<stamp_element_t> &current_sources,
+									   const std::vector<stamp_element_t> &branches,
+									   std::vector<Eigen::Triplet<double>> &triplets)
+	{
+		auto owned = [&](int row) { return row >= row_begin && row < row_end; };
+		auto add = [&](int row, int col, double value) {
+			if (owned(row)) {
+				triplets.emplace_back(row - row_begin, col, value);
+			}
+		};
+
+		triplets.reserve(4 * (resistors.size() + branches.size()));
+
+		for (auto &resistor : resistors) {
+			int pos = resistor.node_positive - 1, neg = resistor.node_negative - 1;
+			double conductance = 1.0 / resistor.value;
+			if (pos >= 0 && neg >= 0) {
+				add(pos, neg, -conductance);
+				add(neg, pos, -conductance);
+			}
+			if (pos >= 0) {
+				add(pos, pos, conductance);
+			}
+			if (neg >= 0) {
+				add(neg, neg, conductance);
+			}
+		}
+
+		for (auto &source : current_sources) {
+			int pos = source.node_positive - 1, neg = source.node_negative - 1;
+			if (pos >= 0 && owned(pos)) {
+				b(pos - row_begin) -= source.value;
+			}
+			if (neg >= 0 && owned(neg)) {
+				b(neg - row_begin) += source.value;
+			}
+		}
+
+		for (auto &branch : branches) {
+			int pos = branch.node_positive - 1, neg = branch.node_negative - 1;
+			int row = total_nodes - 1 + branch.id;
+			if (owned(row)) {
+				b(row - row_begin) = branch.value;
+			}
+			if (pos >= 0) {
+				add(row, pos, 1);
+				add(pos, row, 1);
+			}
+			if (neg >= 0) {
+				add(row, neg, -1);
+				add(neg, row, -1);
+			}
+		}
+	}
+
+	/* Find the ghost columns of the owned rows, remap the columns of the triplets to [owned | ghosts],
+	 * build A and tell every other rank which of its entries this rank needs
+	 */
+	void DistributedSolver::setup_halo(std::vector<Eigen::Triplet<double>> &triplets)
+	{
+		int n_loc = row_end - row_begin;
+
+		ghosts.clear();
+		for (auto &triplet : triplets) {
+			if (triplet.col() < row_begin || triplet.col() >= row_end) {
+				ghosts.push_back(triplet.col());
+			}
+		}
+		std::sort(ghosts.begin(), ghosts.end());
+		ghosts.erase(std::unique(ghosts.begin(), ghosts.end()), ghosts.end());
+
+		for (auto &triplet : triplets) {
+			int col = triplet.col() - row_begin;
+			if (triplet.col() < row_begin || triplet.col() >= row_end) {
+				col = n_loc + (std::lower_bound(ghosts.begin(), ghosts.end(), triplet.col()) - ghosts.begin());
+			}
+			triplet = Eigen::Triplet<double>(triplet.row(), col, triplet.value());
+		}
+		A.resize(n_loc, n_loc + ghosts.size());
+		A.setFromTriplets(triplets.begin(), triplets.end());
+
+		// The ghosts are sorted, so the ones of every owner are contiguous
+		recv_counts.assign(size, 0);
+		for (int g : ghosts) {
+			recv_counts[owner(g)]++;
+		}
+		send_counts.resize(size);
+		MPI_Alltoall(recv_counts.data(), 1, MPI_INT, send_counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+
+		recv_displs.assign(size, 0);
+		send_displs.assign(size, 0);
+		for (int r = 1; r < size; r++) {
+			recv_displs[r] = recv_displs[r - 1] + recv_counts[r - 1];
+			send_displs[r] = send_displs[r - 1] + send_counts[r - 1];
+		}
+
+		send_idx.resize(send_displs[size - 1] + send_counts[size - 1]);
+		MPI_Alltoallv(ghosts.data(), recv_counts.data(), recv_displs.data(), MPI_INT,
+					  send_idx.data(), send_counts.data(), send_displs.data(), MPI_INT, MPI_COMM_WORLD);
+		for (auto &idx : send_idx) {
+			idx -= row_begin;
+		}
+		send_buffer.resize(send_idx.size());
+	}
+
+	/* Fill the ghost entries of p_ext = [owned | ghosts] from their owners */
+	void DistributedSolver::halo_exchange(Eigen::VectorXd &p_ext)
+	{
+		int n_loc = row_end - row_begin;
+
+		for (int i = 0; i < send_idx.size(); i++) {
+			send_buffer[i] = p_ext(send_idx[i]);
+		}
+		MPI_Alltoallv(send_buffer.data(), send_counts.data(), send_displs.data(), MPI_DOUBLE,
+					  p_ext.data() + n_loc, recv_counts.data(), recv_displs.data(), MPI_DOUBLE, MPI_COMM_WORLD);
+		perf_counter.halo_exchanges++;
+	}
+
+	double DistributedSolver::dot(const Eigen::VectorXd &u, const Eigen::VectorXd &v)
+	{
+		double local = u.dot(v), global;
+		MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+		return global;
+	}
+
+	/* The custom CG of the Solver, with the dot products reduced over all the ranks */
+	void DistributedSolver::solve()
+	{
+		double start = MPI_Wtime();
+
+		int n_loc = row_end - row_begin;
+		int cg_iter = 0;
+		double alpha, beta, rho, rho1, cg_error = options.itol + 1;
+
+		Eigen::VectorXd r = b;
+		Eigen::VectorXd z(n_loc);
+		Eigen::VectorXd p(n_loc);
+		Eigen::VectorXd q(n_loc);
+		Eigen::VectorXd p_ext = Eigen::VectorXd::Zero(n_loc + ghosts.size());
+
+		x.setZero();
+		double bnorm = std::sqrt(dot(b, b));
+		if (bnorm < EPS) {
+			iterations = 0;
+			error = 0;
+			return;
+		}
+
+		while (cg_error > options.itol && cg_iter < n) {
+			cg_iter++;
+			z = r.cwiseProduct(inv_precond);
+			rho = dot(r, z);
+
+			if (cg_iter == 1) {
+				p = z;
+			} else {
+				beta = rho / rho1;
+				p = z + beta*p;
+			}
+			rho1 = rho;
+
+			p_ext.head(n_loc) = p;
+			halo_exchange(p_ext);
+			q.noalias() = A * p_ext;
+
+			alpha = rho / dot(p, q);
+			x += alpha*p;
+			r -= alpha*q;
+
+			// Check for convergence
+			cg_error = std::sqrt(dot(r, r)) / bnorm;
+		}
+
+		iterations = cg_iter;
+		error = cg_error;
+		perf_counter.secs_in_solve += MPI_Wtime() - start;
+
+		logger.log(INFO, "Distributed CG: Error was " + std::to_string(error) + " in "
+						 + std::to_string(iterations) + " Iterations: ");
+	}
+
+	/* Gather the voltages of the .PRINT nodes on rank 0, which writes them to filename */
+	void DistributedSolver::dump_print_nodes(std::vector<std::string> &prints, std::filesystem::path filename)
+	{
+		// Only rank 0 has the node table, so it sends the rows of the nodes to the other ranks
+		int count = prints.size();
+		MPI_Bcast(&count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+		std::vector<int> rows(count);
+		if (rank == 0) {
+			for (int i = 0; i < count; i++) {
+				rows[i] = node_table.find_node(&prints[i]) - 1;
+			}
+		}
+		MPI_Bcast(rows.data(), count, MPI_INT, 0, MPI_COMM_WORLD);
+
+		std::vector<double> values(count, 0);
+		std::vector<double> gathered(count, 0);
+		for (int i = 0; i < count; i++) {
+			if (rows[i] >= row_begin && rows[i] < row_end) {
+				values[i] = x(rows[i] - row_begin);
+			}
+		}
+		MPI_Reduce(values.data(), gathered.data(), count, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+		if (rank != 0) {
+			return;
+		}
+
+		if (prints.empty()) {
+			logger.log(WARNING, "No .PRINT nodes, the distributed solution is not gathered");
+		}
+
+		std::ofstream file(filename);
+		if (!file.is_open()) {
+			throw std::runtime_error("Unable to open file for writing: " + filename.string());
+		}
+		file << "Node Voltage" << std::endl;
+		for (int i = 0; i < prints.size(); i++) {
+			file << prints[i] << " "
+				 << std::setprecision(std::numeric_limits<double>::max_digits10)
+				 << gathered[i] << std::endl;
+		}
+		file.close();
+	}
+
+	void DistributedSolver::dump_perf_counters(std::filesystem::path filename, double g_time)
+	{
+		double secs_in_assembly, secs_in_solve;
+		MPI_Reduce(&perf_counter.secs_in_assembly, &secs_in_assembly, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+		MPI_Reduce(&perf_counter.secs_in_solve, &secs_in_solve, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+		if (rank != 0) {
+			return;
+		}
+
+		std::ofstream file(filename.string(), std::ofstream::out);
+		file << "mpi_ranks:\t" << size << std::endl;
+		file << "secs_in_assembly:\t" << secs_in_assembly << std::endl;
+		file << "secs_in_solve:\t" << secs_in_solve << std::endl;
+		file << "halo_exchanges:\t" << perf_counter.halo_exchanges << std::endl;
+		file << "iterations:\t" << iterations << std::endl;
+		file << "total_secs:\t" << g_time << std::endl;
+		file.close();
+	}
+}
+
+#endif
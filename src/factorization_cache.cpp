@@ -0,0 +1,90 @@
+#include <list>
+#include <memory>
+
+#include "factorization_cache.h"
+#include "transient.h"
+
+namespace spic {
+	FactorizationCache::FactorizationCache(Solver &dc_solver, std::shared_ptr<Eigen::SparseMatrix<double>> G,
+										   std::shared_ptr<Eigen::SparseMatrix<double>> C, long budget_bytes)
+		: dc_solver(dc_solver), dc_factored(false), sparse_G(G), sparse_C(C),
+		  budget_bytes(budget_bytes), cached_bytes(0) {}
+
+	FactorizationCache::FactorizationCache(Solver &dc_solver, std::shared_ptr<Eigen::MatrixXd> G,
+										   std::shared_ptr<Eigen::MatrixXd> C, long budget_bytes)
+		: dc_solver(dc_solver), dc_factored(false), G(G), C(C),
+		  budget_bytes(budget_bytes), cached_bytes(0) {}
+
+	// The performance counters of the cached solvers are reported by the DC solver
+	FactorizationCache::~FactorizationCache()
+	{
+		for (auto &e : entries) {
+			dc_solver.add_perf_counters(*e.solver);
+		}
+	}
+
+	/* Solver of A = G + alpha * C, which is moved to the front of the most recently used list.
+	 * A missing one is factored on a copy of A, after the least recently used ones that do not
+	 * fit in the budget together with it have been dropped. The DC solver is factored once.
+	 */
+	Solver &FactorizationCache::get(double alpha)
+	{
+		options_t &ops = dc_solver.options;
+
+		if (alpha == 0) {
+			if (dc_factored) {
+				dc_solver.perf_counter.factorization_hits++;
+			} else {
+				dc_solver.analyze();
+				dc_solver.perf_counter.factorization_misses++;
+				dc_factored = true;
+			}
+			return dc_solver;
+		}
+
+		for (auto it = entries.begin(); it != entries.end(); ++it) {
+			if (it->alpha == alpha) {
+				entries.splice(entries.begin(), entries, it);
+				dc_solver.perf_counter.factorization_hits++;
+				return *entries.front().solver;
+			}
+		}
+
+		entry_t e;
+		e.alpha = alpha;
+		if (ops.sparse) {
+			e.sparse_system = std::make_unique<SparseSystem>(sparse_G->rows());
+			e.sparse_system->A = *sparse_G + alpha * *sparse_C;
+			e.solver = std::make_unique<Solver>(*e.sparse_system, ops, dc_solver.logger);
+
+			// The factorization is assumed to fill A by TRAN_FILL_ESTIMATE,
+			// the iterative methods keep a row-major copy of it
+			e.bytes = e.sparse_system->A.nonZeros() * (sizeof(double) + sizeof(int))
+						* (ops.iter ? 2 : 1 + TRAN_FILL_ESTIMATE);
+		} else {
+			e.system = std::make_unique<System>(G->rows());
+			e.system->A = *G + alpha * *C;
+			e.solver = std::make_unique<Solver>(*e.system, ops, dc_solver.logger);
+			e.bytes = e.system->A.size() * sizeof(double) * (ops.iter ? 1 : 2);
+		}
+
+		evict(e.bytes);
+		e.solver->analyze();
+		dc_solver.perf_counter.factorization_misses++;
+
+		cached_bytes += e.bytes;
+		entries.push_front(std::move(e));
+		return *entries.front().solver;
+	}
+
+	// Drop the least recently used solvers until bytes more fit in the budget
+	void FactorizationCache::evict(long bytes)
+	{
+		while (!entries.empty() && cached_bytes + bytes > budget_bytes) {
+			cached_bytes -= entries.back().bytes;
+			dc_solver.add_perf_counters(*entries.back().solver);
+			dc_solver.perf_counter.factorization_evictions++;
+			entries.pop_back();
+		}
+	}
+}
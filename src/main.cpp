@@ -19,12 +19,16 @@
 #include "sparse_system.h"
 #include "util.h"
 #include "solver.h"
+#include "autotuner.h"
+#include "distributed.h"
 
 spic::Netlist   netlist;
 spic::NodeTable node_table;
 spic::Commands  commands;
 
 extern int error_count;
+extern spic::Scenario *parsed_scenario;
+void lexer_restart(FILE *file);
 
 namespace po = boost::program_options;
 
@@ -33,6 +37,8 @@ void parse_arguments(po::variables_map &vm, int argc, char** argv);
 
 void parse_spice_file(std::filesystem::path cir_file, Logger &logger);
 
+void parse_scenario_files(const std::vector<std::string> &scenario_files, Logger &logger);
+
 void create_directory_structure(const std::filesystem::path &output_dir,
 								const std::filesystem::path &cir_file, 
 								bool bypass_options, Logger &logger);
@@ -42,6 +48,12 @@ void solve_operating_point(spic::Solver *slv, Eigen::VectorXd &x, Eigen::VectorX
 
 bool check_conflicting_options(spic::options_t &options, Logger log);
 
+void exit_error();
+
+#ifdef SPIC_MPI
+void solve_distributed(const std::filesystem::path &output_dir, Logger &logger, double g_timer_start);
+#endif
+
 int main(int argc, char** argv)
 {
 	// and average of solve. Also the parsing and the MNA construction
@@ -49,6 +61,18 @@ int main(int argc, char** argv)
 	double g_timer_start = omp_get_wtime();
 	Logger logger = Logger(std::cout);
 
+	// With more than one MPI rank, only rank 0 parses the circuit and writes output, the other
+	// ranks receive the elements of their rows from it
+	int mpi_rank = 0, mpi_size = 1;
+#ifdef SPIC_MPI
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+	if (mpi_rank != 0) {
+		std::cout.setstate(std::ios::failbit);
+	}
+#endif
+
 	// Define the supported options
 	po::variables_map vm;
 	parse_arguments(vm, argc, argv);
@@ -63,8 +87,23 @@ int main(int argc, char** argv)
 	std::filesystem::path output_dir(output_dir_str);
 
 	// Parse the spice circuit file that constructs the netlist
-	// the node_table and the commands structures
-	parse_spice_file(cir_file, logger);
+	// the node_table and the commands structures. With more than one rank the resistors are
+	// spooled to a temporary file as they are parsed, and rank 0 distributes them from it
+	if (mpi_rank == 0) {
+		if (mpi_size > 1) {
+			netlist.spool = std::tmpfile();
+			if (netlist.spool == NULL) {
+				logger.log(ERROR, "Error creating the temporary file of the resistors");
+				exit_error();
+			}
+		}
+		parse_spice_file(cir_file, logger);
+	}
+
+	// Parse the stimulus files of the transient scenarios, which change sources of the netlist
+	if (vm.count("scenarios") && mpi_rank == 0) {
+		parse_scenario_files(vm["scenarios"].as<std::vector<std::string>>(), logger);
+	}
 
 	// Check if the user want to bypass the .cir options from spic
 	if (bypass_options) {
@@ -73,8 +112,25 @@ int main(int argc, char** argv)
 		commands.options.custom = vm["custom"].as<bool>();
 		commands.options.sparse = vm["sparse"].as<bool>();
 		commands.options.iter = vm["iter"].as<bool>();
+		commands.options.mixed = vm["mixed"].as<bool>();
+		commands.options.gmres = vm["gmres"].as<bool>();
+		commands.options.restart = vm["restart"].as<int>();
+		commands.options.bicgstab = vm["bicgstab"].as<bool>();
+		commands.options.autotune = vm["autotune"].as<bool>();
+		commands.options.scale = vm["scale"].as<bool>();
+		commands.options.deflation = vm["deflation"].as<int>();
+		commands.options.predictor = vm["predictor"].as<int>();
+		commands.options.domains = vm["domains"].as<int>();
+		commands.options.ooc = vm["ooc"].as<int>();
 		commands.options.itol = vm["itol"].as<double>();
-		commands.options.transient_method = (vm["transient_method"].as<std::string>().find("BE") == 0) ? spic::BE : spic::TR;
+		commands.options.lte_tol = vm["ltetol"].as<double>();
+		commands.options.parareal = vm["parareal"].as<int>();
+		commands.options.tran_jobs = vm["tran_jobs"].as<int>();
+		commands.options.fact_cache = vm["fact_cache"].as<int>();
+		std::string transient_method = vm["transient_method"].as<std::string>();
+		commands.options.transient_method = (transient_method.find("BE") == 0) ? spic::BE :
+											(transient_method.find("GEAR") == 0) ? spic::GEAR :
+											(transient_method.find("EXP") == 0) ? spic::EXP : spic::TR;
 	}
 
 	// Show final commands
@@ -82,16 +138,42 @@ int main(int argc, char** argv)
 
 	// Check if the combination of options is valid
 	if (!check_conflicting_options(commands.options, logger)) {
-		exit(1);
+		exit_error();
 	}
 
 	// Create output directory and a copy of the circuit file used
-	create_directory_structure(output_dir, cir_file, bypass_options, logger);
+	if (mpi_rank == 0) {
+		create_directory_structure(output_dir, cir_file, bypass_options, logger);
+	}
 
 	// Initialize Parallelism in Eigen
 	int max_threads = omp_get_max_threads();
 	logger.log(INFO, "Using " + std::to_string(max_threads) + " threads.");
 	Eigen::setNbThreads(max_threads);
+
+	// Replace the solver options with the fastest method for this circuit, the MPI mode always
+	// uses the distributed CG
+	if (commands.options.autotune && mpi_size > 1) {
+		logger.log(WARNING, "Autotune is skipped in the MPI mode");
+	} else if (commands.options.autotune) {
+		spic::Autotuner autotuner(commands.options, logger);
+		autotuner.tune(cir_file.parent_path()/AUTOTUNE_CACHE_FILE);
+		std::cout << commands.options;
+
+		// The selected method must still be valid with the options it does not choose
+		if (!check_conflicting_options(commands.options, logger)) {
+			exit_error();
+		}
+	}
+
+#ifdef SPIC_MPI
+	if (mpi_size > 1) {
+		solve_distributed(output_dir, logger, g_timer_start);
+		MPI_Finalize();
+		return 0;
+	}
+#endif
+
 	spic::Solver *slv;
 
 	// Construct MNA System
@@ -135,7 +217,14 @@ int main(int argc, char** argv)
 		commands.perform_dc_sweeps(slv, logger);
 	}
 
-	// Performance Counters
+	// Perform any existent what-if variants
+	if (!commands.whatifs.empty()) {
+		commands.whatif_dir = output_dir/"whatif";
+		commands.perform_whatifs(slv, logger);
+	}
+
+	// Performance Counters, the cached solvers add theirs to the DC solver when they are dropped
+	commands.factorization_cache.reset();
 	logger.log(INFO, "Dumping performance report.");
 	std::filesystem::path perf_rpt = output_dir/"spic_performance.rpt";
 	double g_total_time = omp_get_wtime() - g_timer_start;
@@ -143,6 +232,9 @@ int main(int argc, char** argv)
 	slv->dump_perf_counters(perf_rpt, g_total_time);
 
 	logger.log(INFO, "Simulator finished. Exiting...");
+#ifdef SPIC_MPI
+	MPI_Finalize();
+#endif
 	return 0;
 }
 
@@ -161,8 +253,23 @@ void parse_arguments(po::variables_map &vm, int argc, char **argv) {
 		("custom", po::bool_switch()->default_value(false), "Enable custom solver option")
 		("sparse", po::bool_switch()->default_value(false), "Enable sparse solver option")
 		("iter", po::bool_switch()->default_value(false), "Enable iterative solver option")
+		("mixed", po::bool_switch()->default_value(false), "Enable mixed precision factorization option")
+		("gmres", po::bool_switch()->default_value(false), "Enable GMRES iterative solver option")
+		("restart", po::value<int>()->default_value(GMRES_DEFAULT_RESTART), "Set GMRES restart length")
+		("bicgstab", po::bool_switch()->default_value(false), "Enable BiCGSTAB iterative solver option")
+		("autotune", po::bool_switch()->default_value(false), "Select the solver options with timed trials")
+		("scale", po::bool_switch()->default_value(false), "Enable row/column equilibration of the MNA matrix")
+		("deflation", po::value<int>()->default_value(0), "Set size of the recycled CG deflation space")
+		("predictor", po::value<int>()->default_value(0), "Set order of the transient initial guess predictor (0-2)")
+		("domains", po::value<int>()->default_value(0), "Set subdomains of the sparse direct Schur complement solver")
+		("ooc", po::value<int>()->default_value(0), "Set memory budget in MB of the out-of-core sparse Cholesky")
 		("itol", po::value<double>()->default_value(1e-3), "Set iteration tolerance")
-		("transient_method", po::value<std::string>()->default_value("TR"), "Set derivative calculation method");
+		("ltetol", po::value<double>()->default_value(0), "Set truncation error tolerance of adaptive transient steps")
+		("parareal", po::value<int>()->default_value(0), "Set time slices of the Parareal transient engine")
+		("tran_jobs", po::value<int>()->default_value(0), "Set transient analyses run concurrently")
+		("fact_cache", po::value<int>()->default_value(0), "Set memory budget in MB of the factorization cache")
+		("scenarios", po::value<std::vector<std::string>>()->multitoken(), "Stimulus files of transient scenarios run together")
+		("transient_method", po::value<std::string>()->default_value("TR"), "Set derivative calculation method (TR, BE, GEAR or EXP)");
 
 	try {
 		po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -188,7 +295,7 @@ void parse_spice_file(std::filesystem::path cir_file, Logger &logger) {
 	yyin = fopen(cir_file.c_str(), "r");
 	if (yyin == NULL) {
 		logger.log(ERROR, "Error opening file " + cir_file.string());
-		exit(1);
+		exit_error();
 	}
 
 	// Call the parser
@@ -201,7 +308,10 @@ void parse_spice_file(std::filesystem::path cir_file, Logger &logger) {
 	// Check for errors
 	if (error_count > 0) {
 		logger.log(ERROR, "Finished parsing with errors.");
-		exit(1);
+		exit_error();
+	} else if (netlist.spool && std::ferror(netlist.spool)) {
+		logger.log(ERROR, "Error writing the resistors to the temporary file.");
+		exit_error();
 	} else {
 		logger.log(INFO, "Parsing finished successfully.");
 	}
@@ -211,6 +321,51 @@ void parse_spice_file(std::filesystem::path cir_file, Logger &logger) {
 	std::cout << netlist;
 }
 
+// Function that parses the stimulus file of every scenario with the parser of the circuit file
+void parse_scenario_files(const std::vector<std::string> &scenario_files, Logger &logger) {
+	for (auto &scenario_file : scenario_files) {
+		yyin = fopen(scenario_file.c_str(), "r");
+		if (yyin == NULL) {
+			logger.log(ERROR, "Error opening file " + scenario_file);
+			exit_error();
+		}
+
+		// The sources of the file are added to the scenario instead of the netlist
+		logger.log(INFO, "Calling parser on scenario " + scenario_file + "...");
+		commands.scenarios.emplace_back(scenario_file);
+		parsed_scenario = &commands.scenarios.back();
+		lexer_restart(yyin);
+		yyparse();
+
+		fclose(yyin);
+
+		if (error_count > 0) {
+			logger.log(ERROR, "Finished parsing scenario " + scenario_file + " with errors.");
+			exit_error();
+		}
+	}
+	parsed_scenario = NULL;
+	logger.log(INFO, "Parsed " + std::to_string(scenario_files.size()) + " scenarios successfully.");
+}
+
+/* Exit on an error. With more than one MPI rank the other ranks may be waiting for this one (e.g. for
+ * the options that only rank 0 parses), so all of them are aborted instead.
+ */
+void exit_error()
+{
+#ifdef SPIC_MPI
+	int initialized, size = 1;
+	MPI_Initialized(&initialized);
+	if (initialized) {
+		MPI_Comm_size(MPI_COMM_WORLD, &size);
+	}
+	if (size > 1) {
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+#endif
+	exit(1);
+}
+
 void create_directory_structure(const std::filesystem::path &output_dir,
 								const std::filesystem::path &cir_file, 
 								bool bypass_options, Logger &logger)
@@ -264,6 +419,19 @@ void create_directory_structure(const std::filesystem::path &output_dir,
 								+ std::string(commands.options.custom ? " CUSTOM" : "")
 								+ std::string(commands.options.sparse ? " SPARSE" : "")
 								+ std::string(commands.options.iter ? " ITER" : "")
+								+ std::string(commands.options.mixed ? " MIXED" : "")
+								+ std::string(commands.options.gmres ? " GMRES RESTART=" + std::to_string(commands.options.restart) : "")
+								+ std::string(commands.options.bicgstab ? " BICGSTAB" : "")
+								+ std::string(commands.options.autotune ? " AUTOTUNE" : "")
+								+ std::string(commands.options.scale ? " SCALE" : "")
+								+ std::string(commands.options.deflation ? " DEFLATION=" + std::to_string(commands.options.deflation) : "")
+								+ std::string(commands.options.predictor ? " PREDICTOR=" + std::to_string(commands.options.predictor) : "")
+								+ std::string(commands.options.domains ? " DOMAINS=" + std::to_string(commands.options.domains) : "")
+								+ std::string(commands.options.ooc ? " OOC=" + std::to_string(commands.options.ooc) : "")
+								+ std::string(commands.options.lte_tol ? " LTETOL=" + std::to_string(commands.options.lte_tol) : "")
+								+ std::string(commands.options.parareal ? " PARAREAL=" + std::to_string(commands.options.parareal) : "")
+								+ std::string(commands.options.tran_jobs ? " TRANJOBS=" + std::to_string(commands.options.tran_jobs) : "")
+								+ std::string(commands.options.fact_cache ? " FACTCACHE=" + std::to_string(commands.options.fact_cache) : "")
 								+ std::string(" ITOL=") + std::to_string(commands.options.itol);
 		out_file << user_options << std::endl;
 		out_file.close();
@@ -273,8 +441,12 @@ void create_directory_structure(const std::filesystem::path &output_dir,
 void solve_operating_point(spic::Solver *slv, Eigen::VectorXd &x, Eigen::VectorXd &b,
 						const std::filesystem::path &output_dir)
 {
-	// Solve MNA system on the operating point
-	slv->analyze();
+	// Solve MNA system on the operating point, with the factorization of G kept by the transients
+	if (commands.factorization_cache) {
+		commands.factorization_cache->get(0.0);
+	} else {
+		slv->analyze();
+	}
 	slv->solve(b);
 
 	// Create the dc_op.dat file in the output directory
@@ -315,5 +487,103 @@ bool check_conflicting_options(spic::options_t &options, Logger logger)
 		logger.log(ERROR, "Custom direct methods are not implemented for sparse matrices");
 		res = false;
 	}
+	if (options.gmres && !options.iter) {
+		logger.log(ERROR, "GMRES requires the iterative solver option");
+		res = false;
+	}
+	if (options.bicgstab && (!options.iter || options.gmres)) {
+		logger.log(ERROR, "BiCGSTAB requires the iterative solver option and excludes GMRES");
+		res = false;
+	}
+	if (options.autotune && (options.deflation > 0 || options.mixed)) {
+		logger.log(ERROR, "Autotune selects the solver method and excludes deflation and mixed precision");
+		res = false;
+	}
+	if (options.deflation > 0 && !(options.iter && options.spd && options.custom && !options.gmres && !options.bicgstab)) {
+		logger.log(ERROR, "Deflation is only implemented for the custom CG method");
+		res = false;
+	}
+	if (options.predictor < 0 || options.predictor > MAX_PREDICTOR_ORDER) {
+		logger.log(ERROR, "Predictor order must be between 0 and " + std::to_string(MAX_PREDICTOR_ORDER));
+		res = false;
+	}
+	if (options.domains > 1 && !(options.sparse && !options.iter && !options.custom && !options.mixed)) {
+		logger.log(ERROR, "Domain decomposition is only implemented for the sparse integrated direct methods");
+		res = false;
+	}
+	if (options.ooc > 0 && !(options.sparse && options.spd && !options.iter && !options.custom && !options.mixed && options.domains <= 1)) {
+		logger.log(ERROR, "Out-of-core factorization is only implemented for the sparse integrated Cholesky");
+		res = false;
+	}
+	if (options.lte_tol < 0) {
+		logger.log(ERROR, "The truncation error tolerance of adaptive transient steps must not be negative");
+		res = false;
+	}
+	if (options.lte_tol > 0 && options.transient_method == spic::EXP) {
+		logger.log(ERROR, "Adaptive transient steps are not implemented for the exponential method");
+		res = false;
+	}
+	if (options.parareal < 0) {
+		logger.log(ERROR, "The number of Parareal time slices must not be negative");
+		res = false;
+	}
+	if (options.parareal > 1 && (options.lte_tol > 0 || !(options.transient_method == spic::TR || options.transient_method == spic::BE))) {
+		logger.log(ERROR, "Parareal is only implemented for the fixed step TR and BE methods");
+		res = false;
+	}
+	if (options.tran_jobs < 0) {
+		logger.log(ERROR, "The number of concurrent transient analyses must not be negative");
+		res = false;
+	}
+	if (options.fact_cache < 0) {
+		logger.log(ERROR, "The memory budget of the factorization cache must not be negative");
+		res = false;
+	}
+	if (!commands.scenarios.empty() && (options.lte_tol > 0 || options.parareal > 1 || options.transient_method == spic::EXP)) {
+		logger.log(ERROR, "Transient scenarios are only implemented for the fixed step TR, BE and GEAR methods");
+		res = false;
+	}
+	if (options.mixed && (options.iter || options.custom)) {
+		logger.log(ERROR, "Mixed precision is only implemented for the integrated direct methods");
+		res = false;
+	}
 	return res;
-}
\ No newline at end of file
+}
+
+#ifdef SPIC_MPI
+/* Solve the operating point with the distributed CG and gather the .PRINT nodes,
+ * the transient analyses and the DC sweeps are only supported by a single process
+ */
+void solve_distributed(const std::filesystem::path &output_dir, Logger &logger, double g_timer_start)
+{
+	// The options of the circuit file were only parsed by rank 0
+	MPI_Bcast(&commands.options, sizeof(spic::options_t), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+	if (!(commands.options.sparse && commands.options.iter && commands.options.spd)) {
+		logger.log(ERROR, "The MPI mode requires the sparse, iterative and SPD options");
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+	if (!commands.transient_list.empty() || !commands.v_dc_sweeps.empty() || !commands.i_dc_sweeps.empty()) {
+		logger.log(WARNING, "Transient analyses and DC sweeps are skipped in the MPI mode");
+	}
+
+	// Wait for rank 0 to create the output directory
+	MPI_Barrier(MPI_COMM_WORLD);
+
+	logger.log(INFO, "Constructing distributed MNA System for DC analysis.");
+	spic::DistributedSolver slv(netlist, node_table.size(), commands.options, logger);
+	if (netlist.spool) {
+		std::fclose(netlist.spool);
+		netlist.spool = nullptr;
+	}
+	slv.solve();
+	slv.dump_print_nodes(commands.print_nodes, output_dir/"dc_op.dat");
+
+	logger.log(INFO, "Dumping performance report.");
+	double g_total_time = omp_get_wtime() - g_timer_start;
+	logger.log(INFO, "spic execution time was " + std::to_string(g_total_time));
+	slv.dump_perf_counters(output_dir/"spic_performance.rpt", g_total_time);
+
+	logger.log(INFO, "Simulator finished. Exiting...");
+}
+#endif
@@ -13,9 +13,18 @@ namespace spic {
 		return current_sources.add_element(i);
 	}
 	bool Netlist::add_resistor(Resistor *r) {
+		if (spool) {
+			spooled_resistor_t resistor = {r->node_positive, r->node_negative, r->value};
+			std::fwrite(&resistor, sizeof(resistor), 1, spool);
+			spooled_resistors++;
+			return true;
+		}
 		return resistors.add_element(r);
 	}
 	bool Netlist::add_capacitor(Capacitor *c) {
+		if (spool) {
+			return true;
+		}
 		return capacitors.add_element(c);
 	}
 	bool Netlist::add_inductor(Inductor *l) {
@@ -31,6 +40,11 @@ namespace spic {
 		return bjt.add_element(q);
 	}
 
+	// A netlist is linear if it contains no diodes or transistors
+	bool Netlist::is_linear() {
+		return diodes.empty() && mos.empty() && bjt.empty();
+	}
+
 	// Eval wrapper for Sources' Transient value
 	double Source::eval(double t)
 	{
@@ -157,7 +171,7 @@ std::ostream& operator<<(std::ostream &out, spic::Netlist &nl) {
 	out << "Netlist consists of:" << std::endl;
 	out << "\t" <<  nl.voltage_sources.size() << " voltage sources" << std::endl;
 	out << "\t" <<  nl.current_sources.size() << " current sources" << std::endl;
-	out << "\t" <<  nl.resistors.size()       << " resistors" << std::endl;
+	out << "\t" <<  nl.resistors.size() + nl.spooled_resistors << " resistors" << std::endl;
 	out << "\t" <<  nl.capacitors.size()      << " capacitors" << std::endl;
 	out << "\t" <<  nl.inductors.size()       << " inductors" << std::endl;
 	out << "\t" <<  nl.diodes.size()          << " diode" << std::endl;
@@ -0,0 +1,248 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "ooc_cholesky.h"
+
+namespace spic {
+	OutOfCoreCholesky::OutOfCoreCholesky(const Eigen::SparseMatrix<double> &A, long budget_bytes, Logger &logger)
+		: n(A.rows()), logger(logger), fd(-1), file_size(0)
+	{
+		panel_bytes = std::max<long>(budget_bytes / OOC_PANELS_IN_BUDGET, sysconf(_SC_PAGESIZE));
+
+		// Fill reducing ordering, as in Eigen's SimplicialLLT
+		Eigen::AMDOrdering<int> ordering;
+		ordering(A.selfadjointView<Eigen::Lower>(), Pinv);
+		P = Pinv.inverse();
+		C = A.selfadjointView<Eigen::Lower>().twistedBy(P);
+
+		// The scratch file is unlinked at once, it only lives while it is open.
+		// Concurrent transient analyses factor at the same time, so every instance has its own name.
+		static std::atomic<int> instances(0);
+		std::filesystem::path scratch = std::filesystem::temp_directory_path()
+										/ ("spic_ooc_" + std::to_string(getpid()) + "_"
+										   + std::to_string(instances++) + ".bin");
+		fd = open(scratch.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+		if (fd < 0) {
+			logger.log(ERROR, "OutOfCoreCholesky(): unable to create " + scratch.string());
+		} else {
+			unlink(scratch.c_str());
+		}
+	}
+
+	OutOfCoreCholesky::~OutOfCoreCholesky()
+	{
+		for (int i = 0; i < panel_maps.size(); i++) {
+			munmap(panel_maps[i], panel_sizes[i]);
+		}
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+
+	/* Elimination tree of C from its upper triangular part (CSparse's cs_etree) */
+	void OutOfCoreCholesky::etree()
+	{
+		std::vector<int> ancestor(n, -1);
+		parent.assign(n, -1);
+
+		for (int k = 0; k < n; k++) {
+			for (Eigen::SparseMatrix<double>::InnerIterator it(C, k); it; ++it) {
+				int i = it.row(), next;
+				for (; i != -1 && i < k; i = next) {
+					next = ancestor[i];
+					ancestor[i] = k;
+					if (next == -1) {
+						parent[i] = k;
+					}
+				}
+			}
+		}
+	}
+
+	/* Pattern of row k of L, from the paths of the etree that start at the entries of C(0:k-1, k).
+	 * The pattern is returned in s[top, n).
+	 */
+	int OutOfCoreCholesky::ereach(int k, std::vector<int> &s, std::vector<int> &w)
+	{
+		int top = n;
+		w[k] = k;
+		for (Eigen::SparseMatrix<double>::InnerIterator it(C, k); it; ++it) {
+			int i = it.row(), len = 0;
+			if (i >= k) {
+				continue;
+			}
+			for (; w[i] != k; i = parent[i]) {
+				s[len++] = i;
+				w[i] = k;
+			}
+			while (len > 0) {
+				s[--top] = s[--len];
+			}
+		}
+		return top;
+	}
+
+	const OutOfCoreCholesky::entry_t *OutOfCoreCholesky::column(int j)
+	{
+		if (col_panel[j] == panel_maps.size()) {
+			return buffer.data() + col_offset[j];
+		}
+		return panel_maps[col_panel[j]] + col_offset[j];
+	}
+
+	/* Append the filled panel to the scratch file with one write and map it back */
+	bool OutOfCoreCholesky::flush()
+	{
+		if (buffer.empty()) {
+			return true;
+		}
+
+		long bytes = buffer.size() * sizeof(entry_t);
+		const char *data = reinterpret_cast<const char*>(buffer.data());
+		for (long written = 0; written < bytes; ) {
+			ssize_t res = pwrite(fd, data + written, bytes - written, file_size + written);
+			if (res < 0) {
+				logger.log(ERROR, "OutOfCoreCholesky::flush(): write to the scratch file failed.");
+				return false;
+			}
+			written += res;
+		}
+
+		void *map = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, file_size);
+		if (map == MAP_FAILED) {
+			logger.log(ERROR, "OutOfCoreCholesky::flush(): mapping of the scratch file failed.");
+			return false;
+		}
+		panel_maps.push_back(static_cast<entry_t*>(map));
+		panel_sizes.push_back(bytes);
+
+		// The next panel starts at a page boundary, as required by mmap
+		long page = sysconf(_SC_PAGESIZE);
+		file_size += (bytes + page - 1) / page * page;
+
+		buffer.clear();
+		return true;
+	}
+
+	/* Column j of L is computed from the columns k < j with L(j, k) != 0:
+	 * L(j:n, j) = (C(j:n, j) - sum(L(j:n, k) L(j, k))) / L(j, j)
+	 * Since j grows, next[k] always points to the entry L(j, k) of column k.
+	 */
+	bool OutOfCoreCholesky::compute()
+	{
+		if (fd < 0) {
+			return false;
+		}
+
+		etree();
+
+		col_panel.resize(n);
+		col_offset.resize(n);
+		col_len.resize(n);
+		buffer.reserve(panel_bytes / sizeof(entry_t) + n);
+
+		std::vector<long> next(n, 1); // Entry of column k with the next row to be reached
+		std::vector<int> s(n), w(n, -1), touched;
+		std::vector<bool> is_touched(n, false);
+		Eigen::VectorXd x = Eigen::VectorXd::Zero(n);
+
+		for (int j = 0; j < n; j++) {
+			// Scatter the lower part of C(:, j)
+			touched.clear();
+			for (Eigen::SparseMatrix<double>::InnerIterator it(C, j); it; ++it) {
+				if (it.row() < j) {
+					continue;
+				}
+				x[it.row()] += it.value();
+				if (it.row() > j && !is_touched[it.row()]) {
+					is_touched[it.row()] = true;
+					touched.push_back(it.row());
+				}
+			}
+
+			// Apply the updates of the columns in the pattern of row j
+			int top = ereach(j, s, w);
+			for (int p = top; p < n; p++) {
+				int k = s[p];
+				const entry_t *col_k = column(k);
+				double ljk = col_k[next[k]].value;
+				for (long q = next[k]; q < col_len[k]; q++) {
+					int i = col_k[q].row;
+					x[i] -= col_k[q].value * ljk;
+					if (i > j && !is_touched[i]) {
+						is_touched[i] = true;
+						touched.push_back(i);
+					}
+				}
+				next[k]++;
+			}
+
+			double d = x[j];
+			x[j] = 0;
+			if (d <= 0) {
+				logger.log(WARNING, "OutOfCoreCholesky::compute(): the matrix is not SPD.");
+				return false;
+			}
+			double ljj = std::sqrt(d);
+
+			// Append column j to the panel, the diagonal first and then the rows in order
+			std::sort(touched.begin(), touched.end());
+			if ((buffer.size() + touched.size() + 1) * sizeof(entry_t) > panel_bytes && !flush()) {
+				return false;
+			}
+			col_panel[j] = panel_maps.size();
+			col_offset[j] = buffer.size();
+			col_len[j] = touched.size() + 1;
+			buffer.push_back({j, ljj});
+			for (int i : touched) {
+				buffer.push_back({i, x[i] / ljj});
+				x[i] = 0;
+				is_touched[i] = false;
+			}
+		}
+
+		if (!flush()) {
+			return false;
+		}
+
+		logger.log(INFO, "OutOfCoreCholesky::compute(): spilled " + std::to_string(file_size)
+						 + " bytes of L in " + std::to_string(panel_maps.size()) + " panels.");
+		return true;
+	}
+
+	/* Stream the panels forward for L y = P b and backward for L^T z = y, then x = P^-1 z */
+	Eigen::MatrixXd OutOfCoreCholesky::solve(const Eigen::MatrixXd &B)
+	{
+		Eigen::MatrixXd Y = P * B;
+
+		for (int i = 0; i < panel_maps.size(); i++) {
+			madvise(panel_maps[i], panel_sizes[i], MADV_SEQUENTIAL);
+		}
+
+		for (int j = 0; j < n; j++) {
+			const entry_t *col_j = column(j);
+			Y.row(j) /= col_j[0].value;
+			for (int q = 1; q < col_len[j]; q++) {
+				Y.row(col_j[q].row) -= col_j[q].value * Y.row(j);
+			}
+		}
+
+		for (int j = n - 1; j >= 0; j--) {
+			const entry_t *col_j = column(j);
+			for (int q = 1; q < col_len[j]; q++) {
+				Y.row(j) -= col_j[q].value * Y.row(col_j[q].row);
+			}
+			Y.row(j) /= col_j[0].value;
+		}
+
+		return Pinv * Y;
+	}
+}
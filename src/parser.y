@@ -9,6 +9,7 @@
 	#include "parser.h"
 
 	std::vector<std::string> *global_node_list_ptr;
+	spic::Scenario *parsed_scenario = NULL; // Scenario whose file is parsed, NULL while parsing the netlist
 
 	extern FILE *yyin;
 	extern int error_count;
@@ -19,6 +20,9 @@
 	spic::node_id_t find_or_append_node_str(std::string *node);
 	void check_add_element(bool res, const std::string &element_name, const std::string &name);
 	void check_dc_sweep(bool res, const std::string &element_name, const std::string &name);
+	void check_whatif_change(bool res, const std::string &element_name, const std::string &name);
+	void check_scenario_source(bool res, const std::string &element_name, const std::string &name);
+	bool in_scenario(const std::string &element_name, const std::string &name);
 	void add_node_to_list(std::string *node_name);
 	void check_commands();
 %}
@@ -63,6 +67,20 @@
 %token T_CUSTOM		"MNA system should be solved with custom solver"
 %token T_ITER		"MNA system should be solved with iterative method"
 %token T_SPARSE		"Sparse matrix option"
+%token T_MIXED		"Mixed precision factorization option"
+%token T_GMRES		"MNA system should be solved with restarted GMRES when using iterative methods"
+%token T_RESTART	"Restart length of GMRES"
+%token T_BICGSTAB	"MNA system should be solved with BiCGSTAB when using iterative methods"
+%token T_AUTOTUNE	"Solver options should be selected by timed trials"
+%token T_SCALE		"MNA matrix should be equilibrated before solving"
+%token T_DEFLATION	"Size of the deflation space recycled across custom CG solves"
+%token T_PREDICTOR	"Order of the initial guess predictor of iterative transient solves"
+%token T_DOMAINS	"Subdomains of the Schur complement solver for sparse direct methods"
+%token T_OOC		"Memory budget in MB of the out-of-core sparse Cholesky"
+%token T_LTETOL	"Tolerance of the local truncation error of adaptive transient steps"
+%token T_PARAREAL	"Time slices of the Parareal transient engine"
+%token T_TRANJOBS	"Transient analyses run concurrently"
+%token T_FACTCACHE	"Memory budget in MB of the factorization cache"
 %token T_ITOL		"MNA sytem should be solved with defined tolerance when using iterative methods"
 %token T_DC			".DC"
 %token T_PRINT		".PRINT"
@@ -75,7 +93,10 @@
 %token T_LPAR		"Left Parenthesis"
 %token T_METHOD_BE 	"Backward Euler Method"
 %token T_METHOD_TR	"Trapezoidal Rule Method"
+%token T_METHOD_GEAR	"Second order Gear (BDF2) Method"
+%token T_METHOD_EXP	"Exponential (Krylov) Method"
 %token T_TRAN		".TRAN"
+%token T_WHATIF		".WHATIF"
 %token T_COMMA		"comma"
 
 
@@ -104,17 +125,19 @@
 /* Rules */
 
 // Structure of the file
-spicefile: netlist commands { check_commands(); }
+spicefile: netlist commands { if (!parsed_scenario) check_commands(); }
 
 // Netlist can contain multiple elements
-netlist:  netlist v { check_add_element(netlist.add_voltage_source($2),	"Voltage Source",	$2->name); delete $2; }
-		| netlist i { check_add_element(netlist.add_current_source($2),	"Current Source",	$2->name); delete $2; }
-		| netlist r { check_add_element(netlist.add_resistor($2), 		"Resistor",			$2->name); delete $2; }
-		| netlist c { check_add_element(netlist.add_capacitor($2), 		"Capacitor",		$2->name); delete $2; }
-		| netlist l { check_add_element(netlist.add_inductor($2), 		"Inductor",			$2->name); delete $2; }
-		| netlist d { check_add_element(netlist.add_diode($2), 			"Diode",			$2->name); delete $2; }
-		| netlist m { check_add_element(netlist.add_mos($2), 			"MOS",				$2->name); delete $2; }
-		| netlist q { check_add_element(netlist.add_bjt($2), 			"BJT",				$2->name); delete $2; }
+netlist:  netlist v { if (parsed_scenario) check_scenario_source(parsed_scenario->change_voltage_source(*$2), "Voltage Source", $2->name);
+					  else check_add_element(netlist.add_voltage_source($2),	"Voltage Source",	$2->name); delete $2; }
+		| netlist i { if (parsed_scenario) check_scenario_source(parsed_scenario->change_current_source(*$2), "Current Source", $2->name);
+					  else check_add_element(netlist.add_current_source($2),	"Current Source",	$2->name); delete $2; }
+		| netlist r { if (!in_scenario("Resistor", $2->name)) check_add_element(netlist.add_resistor($2), 		"Resistor",			$2->name); delete $2; }
+		| netlist c { if (!in_scenario("Capacitor", $2->name)) check_add_element(netlist.add_capacitor($2), 		"Capacitor",		$2->name); delete $2; }
+		| netlist l { if (!in_scenario("Inductor", $2->name)) check_add_element(netlist.add_inductor($2), 		"Inductor",			$2->name); delete $2; }
+		| netlist d { if (!in_scenario("Diode", $2->name)) check_add_element(netlist.add_diode($2), 			"Diode",			$2->name); delete $2; }
+		| netlist m { if (!in_scenario("MOS", $2->name)) check_add_element(netlist.add_mos($2), 			"MOS",				$2->name); delete $2; }
+		| netlist q { if (!in_scenario("BJT", $2->name)) check_add_element(netlist.add_bjt($2), 			"BJT",				$2->name); delete $2; }
 		| /* empty */
 
 // Specifications for each element
@@ -161,7 +184,7 @@ pos_value: T_FLOAT
 	| T_INTEGER         { $$ = (float)  $1; }
 
 
-commands: command commands
+commands: command commands { if (parsed_scenario) yyerror("Only sources may be given in a scenario file"); }
 		| /* empty */
 
 // Options for the simulation
@@ -171,6 +194,15 @@ command:  T_OPTIONS options
 		| T_PRINT { global_node_list_ptr = &commands.print_nodes; } v_nodes
 		| T_PLOT  { global_node_list_ptr = &commands.plot_nodes;  } v_nodes
 		| T_TRAN value value { commands.transient_list.push_back(spic::TransientAnalysis($2, $3)); }
+		| T_WHATIF { commands.whatifs.push_back(spic::WhatIf()); } whatif_changes
+
+// Every .WHATIF command is a variant of the circuit with one or more changed element values
+whatif_changes: whatif_changes whatif_change
+		| whatif_change
+
+whatif_change: T_R value { check_whatif_change(commands.whatifs.back().change_resistor(*$1, $2), "Resistor", *$1); delete $1; }
+		| T_V value { check_whatif_change(commands.whatifs.back().change_voltage_source(*$1, $2), "Voltage Source", *$1); delete $1; }
+		| T_I value { check_whatif_change(commands.whatifs.back().change_current_source(*$1, $2), "Current Source", *$1); delete $1; }
 
 options : option options
 		| /* empty */
@@ -180,19 +212,36 @@ option:   T_SPD          { commands.options.spd = true; }
 		| T_ITER         { commands.options.iter = true; }
 		| T_ITOL T_FLOAT { commands.options.itol = $2; }
 		| T_SPARSE       { commands.options.sparse = true; }
+		| T_MIXED        { commands.options.mixed = true; }
+		| T_GMRES        { commands.options.gmres = true; }
+		| T_RESTART T_INTEGER { commands.options.restart = $2; }
+		| T_BICGSTAB     { commands.options.bicgstab = true; }
+		| T_AUTOTUNE     { commands.options.autotune = true; }
+		| T_SCALE        { commands.options.scale = true; }
+		| T_DEFLATION T_INTEGER { commands.options.deflation = $2; }
+		| T_PREDICTOR T_INTEGER { commands.options.predictor = $2; }
+		| T_DOMAINS T_INTEGER { commands.options.domains = $2; }
+		| T_OOC T_INTEGER { commands.options.ooc = $2; }
+		| T_LTETOL T_FLOAT { commands.options.lte_tol = $2; }
+		| T_PARAREAL T_INTEGER { commands.options.parareal = $2; }
+		| T_TRANJOBS T_INTEGER { commands.options.tran_jobs = $2; }
+		| T_FACTCACHE T_INTEGER { commands.options.fact_cache = $2; }
 		| T_METHOD_BE    { commands.options.transient_method = spic::BE; }
 		| T_METHOD_TR    { commands.options.transient_method = spic::TR; }
+		| T_METHOD_GEAR  { commands.options.transient_method = spic::GEAR; }
+		| T_METHOD_EXP   { commands.options.transient_method = spic::EXP; }
 
 v_nodes: v_nodes T_VNODE { add_node_to_list($2); delete $2; }
 	| T_VNODE            { add_node_to_list($1); delete $1; }
 
 %%
 
-/* Search for an int node in the NodeTable and if it doesn't exist append it */
+/* Search for an int node in the NodeTable and if it doesn't exist append it,
+ * a scenario may not add nodes so its unknown nodes stay negative */
 spic::node_id_t find_or_append_node_int(int node)
 {
 	spic::node_id_t id = node_table.find_node(node);
-	if (id < 0)
+	if (id < 0 && !parsed_scenario)
 		id = node_table.append_node(node);
 	return id;
 }
@@ -201,7 +250,7 @@ spic::node_id_t find_or_append_node_int(int node)
 spic::node_id_t find_or_append_node_str(std::string *node)
 {
 	spic::node_id_t id = node_table.find_node(node);
-	if (id < 0)
+	if (id < 0 && !parsed_scenario)
 		id = node_table.append_node(node);
 	return id;
 }
@@ -222,6 +271,31 @@ void check_dc_sweep(bool res, const std::string &element_name, const std::string
 	}
 }
 
+/* Checks the return value of a What-If change and prints error message if needed */
+void check_whatif_change(bool res, const std::string &element_name, const std::string &name)
+{
+	if (!res) {
+		yyerror(("What-If on non-existent or repeated " + element_name + " name or invalid value: '" + name + "'").c_str());
+	}
+}
+
+/* Checks the return value of a scenario source and prints error message if needed */
+void check_scenario_source(bool res, const std::string &element_name, const std::string &name)
+{
+	if (!res) {
+		yyerror(("Scenario on non-existent, reconnected or repeated " + element_name + " name: '" + name + "'").c_str());
+	}
+}
+
+/* Prints error message for the elements other than sources in a scenario file */
+bool in_scenario(const std::string &element_name, const std::string &name)
+{
+	if (parsed_scenario) {
+		yyerror(("Only sources may be given in a scenario file, found " + element_name + " name: '" + name + "'").c_str());
+	}
+	return parsed_scenario;
+}
+
 /* Searched for a node in a list and  */
 void add_node_to_list(std::string *node_name)
 {
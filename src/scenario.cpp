@@ -0,0 +1,72 @@
+#include "scenario.h"
+#include "netlist.h"
+
+namespace spic {
+	/* The source must exist in the netlist on the same nodes, and be given once in the scenario */
+	bool Scenario::change_voltage_source(VoltageSource &v)
+	{
+		int id = netlist.voltage_sources.find_element_name(v.name);
+		if (id == -1) {
+			return false;
+		}
+
+		VoltageSource &original = netlist.voltage_sources.elements[id];
+		if (v.node_positive != original.node_positive || v.node_negative != original.node_negative) {
+			return false;
+		}
+		return voltage_sources.emplace(id, v).second;
+	}
+
+	bool Scenario::change_current_source(CurrentSource &i)
+	{
+		int id = netlist.current_sources.find_element_name(i.name);
+		if (id == -1) {
+			return false;
+		}
+
+		CurrentSource &original = netlist.current_sources.elements[id];
+		if (i.node_positive != original.node_positive || i.node_negative != original.node_negative) {
+			return false;
+		}
+		return current_sources.emplace(id, i).second;
+	}
+
+	/* The source of the scenario, or that of the netlist if the scenario does not replace it */
+	Source &Scenario::voltage_source(int id)
+	{
+		auto it = voltage_sources.find(id);
+		if (it != voltage_sources.end()) {
+			return it->second;
+		}
+		return netlist.voltage_sources.elements[id];
+	}
+
+	Source &Scenario::current_source(int id)
+	{
+		auto it = current_sources.find(id);
+		if (it != current_sources.end()) {
+			return it->second;
+		}
+		return netlist.current_sources.elements[id];
+	}
+}
+
+std::ostream& operator<<(std::ostream &out, const spic::Scenario &scenario) {
+	out << scenario.file.string() << ":";
+	for (const auto &[id, v] : scenario.voltage_sources) {
+		out << " V" << v.name;
+	}
+	for (const auto &[id, i] : scenario.current_sources) {
+		out << " I" << i.name;
+	}
+	out << std::endl;
+	return out;
+}
+
+std::ostream& operator<<(std::ostream &out, const std::vector<spic::Scenario> &scenarios) {
+	out << "\tTransient Scenarios:" << std::endl;
+	for (const auto &scenario : scenarios) {
+		out << "\t\t * " << scenario;
+	}
+	return out;
+}
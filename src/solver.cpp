@@ -1,5 +1,7 @@
 #include <cmath>
 #include <iostream>
+#include <algorithm>
+#include <unistd.h>
 #include <omp.h>
 
 #include <Eigen/LU>
@@ -19,41 +21,30 @@ namespace spic {
 	{
 		if (options.sparse) {
 			logger.log(INFO, "LU_integrated_decompose: called with a sparse system.");
-			sparse_lu = new Eigen::SparseLU<Eigen::SparseMatrix<double>>(sparse_system->A);
+			sparse_lu = std::make_unique<Eigen::SparseLU<Eigen::SparseMatrix<double>>>(sparse_system->A);
 		} else {
 			logger.log(INFO, "LU_integrated_decompose: called with a dense system.");
-			lu = new Eigen::PartialPivLU<Eigen::Ref<Eigen::MatrixXd>>(system->A);
+			lu = std::make_unique<Eigen::PartialPivLU<Eigen::Ref<Eigen::MatrixXd>>>(system->A);
 		}
 		return true;
 	}
 
-	void Solver::LU_integrated_solve(const Eigen::VectorXd &b)
-	{
-		if (options.sparse) {
-			if (!successful_decomposition || !sparse_lu) {
-				logger.log(ERROR, "LU_integrated_solve(): called without a decomposition.");
-			}
-			sparse_system->x = sparse_lu->solve(b);
-		} else {
-			if (!successful_decomposition || !lu) {
-				logger.log(ERROR, "LU_integrated_solve(): called without a decomposition.");
-			}
-			system->x = lu->solve(b);
-		}
-	}
-
 	bool Solver::cholesky_integrated_decompose()
 	{
-		if (options.sparse) {
+		if (options.sparse && options.ooc > 0) {
+			logger.log(INFO, "cholesky_integrated_decompose: called with a sparse system out of core.");
+			sparse_cholesky_ooc = std::make_unique<OutOfCoreCholesky>(sparse_system->A, (long)options.ooc << 20, logger);
+			return sparse_cholesky_ooc->compute();
+		} else if (options.sparse) {
 			logger.log(INFO, "cholesky_integrated_decompose: called with a sparse system.");
-			sparse_cholesky = new Eigen::SimplicialLLT<Eigen::SparseMatrix<double>, Eigen::Lower, Eigen::COLAMDOrdering<int>>(sparse_system->A);
+			sparse_cholesky = std::make_unique<Eigen::SimplicialLLT<Eigen::SparseMatrix<double>, Eigen::Lower, Eigen::COLAMDOrdering<int>>>(sparse_system->A);
 			if (sparse_cholesky->info() != Eigen::Success) {
 				logger.log(WARNING, "cholesky_integrated_decomposition(): failed, MNA System is not SPD.");
 				return false;
 			}
 		} else {
 			logger.log(INFO, "cholesky_integrated_decompose called with a dense system.");
-			cholesky = new Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>>(system->A);
+			cholesky = std::make_unique<Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>>>(system->A);
 			if (cholesky->info() != Eigen::Success) {
 				logger.log(WARNING, "cholesky_integrated_decomposition(): failed, MNA System is not SPD.");
 				return false;
@@ -62,30 +53,13 @@ namespace spic {
 		return true;
 	}
 
-	void Solver::cholesky_integrated_solve(const Eigen::VectorXd &b)
-	{
-
-		if (options.sparse) {
-			if (!successful_decomposition || sparse_cholesky->info() != Eigen::Success) {
-				logger.log(ERROR, "cholesky_integrated_solve(): called without a successful decomposition.");
-			}
-			sparse_system->x = sparse_cholesky->solve(b);
-		} else {
-			if (!successful_decomposition || cholesky->info() != Eigen::Success) {
-				logger.log(ERROR, "cholesky_integrated_solve(): called without a successful decomposition.");
-				return;
-			}
-			system->x = cholesky->solve(b);
-		}
-	}
-
 	bool Solver::LU_custom_decompose()
 	{
 		logger.log(INFO, "LU_custom_decompose(): called.");
 
 		Eigen::MatrixXd &A = system->A;
 		int n = system->n;
-		perm = new Eigen::VectorXi(n);
+		perm = std::make_unique<Eigen::VectorXi>(n);
 
 		// Initialize permutation vector
 		for (int i = 0; i < n; i++) {
@@ -159,6 +133,29 @@ namespace spic {
 		}
 	}
 
+	/* Multi-RHS version of LU_custom_solve, every row of L/U is applied to all the columns at once */
+	void Solver::LU_custom_solve(const Eigen::MatrixXd &B, Eigen::MatrixXd &X)
+	{
+		if (!successful_decomposition || !perm) {
+			logger.log(ERROR, "LU_custom_solve(): called without a successful decomposition.");
+			return;
+		}
+		Eigen::MatrixXd &A = system->A;
+		int n = system->n;
+		X.resize(n, B.cols());
+
+		// Forward substitution
+		for (int i = 0; i < n; i++) {
+			X.row(i) = B.row((*perm)(i)) - A.row(i).head(i) * X.topRows(i);
+		}
+
+		// Backward substitution
+		for (int i = n - 1; i >= 0; i--) {
+			X.row(i) -= A.row(i).tail(n - i - 1) * X.bottomRows(n - i - 1);
+			X.row(i) /= A(i,i);
+		}
+	}
+
 	bool Solver::cholesky_custom_decompose()
 	{
 		logger.log(INFO, "cholesky_custom_decompose(): called.");
@@ -220,85 +217,125 @@ namespace spic {
 		}
 	}
 
+	/* Multi-RHS version of cholesky_custom_solve, every row of L/L^T is applied to all the columns at once */
+	void Solver::cholesky_custom_solve(const Eigen::MatrixXd &B, Eigen::MatrixXd &X)
+	{
+		if (!successful_decomposition) {
+			logger.log(ERROR, "cholesky_custom_solve(): called without a successful decomposition.");
+			return;
+		}
+		Eigen::MatrixXd &A = system->A;
+		int n = system->n;
+		X.resize(n, B.cols());
+
+		// Forward substitution
+		for (int i = 0; i < n; i++) {
+			X.row(i) = (B.row(i) - A.row(i).head(i) * X.topRows(i)) / A(i,i);
+		}
+
+		// Backward substitution, L^T(i,j) is read from A(j,i) since L^T is not stored
+		for (int i = n - 1; i >= 0; i--) {
+			X.row(i) -= A.col(i).tail(n - i - 1).transpose() * X.bottomRows(n - i - 1);
+			X.row(i) /= A(i,i);
+		}
+	}
+
 
 	/* CG Method integrated compute */
 	void Solver::CG_integrated_compute()
 	{
 		if (options.sparse) {
 			logger.log(INFO, "CG_integrated_compute(): called with a sparse system.");
-			sparse_cg = new Eigen::ConjugateGradient<Eigen::SparseMatrix<double>, Eigen::Lower|Eigen::Upper>(sparse_system->A);
+			sparse_cg = std::make_unique<Eigen::ConjugateGradient<Eigen::SparseMatrix<double>, Eigen::Lower|Eigen::Upper>>(sparse_system->A);
 			sparse_cg->setTolerance(options.itol);
 		} else {
 			logger.log(INFO, "CG_integrated_compute(): called with a dense system.");
-			cg = new Eigen::ConjugateGradient<Eigen::MatrixXd, Eigen::Lower|Eigen::Upper>(system->A);
+			cg = std::make_unique<Eigen::ConjugateGradient<Eigen::MatrixXd, Eigen::Lower|Eigen::Upper>>(system->A);
 			cg->setTolerance(options.itol);
 		}
 	}
 
-	void Solver::CG_integrated_solve(const Eigen::VectorXd &b)
-	{
-		if (options.sparse) {
-			sparse_system->x = sparse_cg->solveWithGuess(b, sparse_system->x);
-			iterations = sparse_cg->iterations();
-			error = sparse_cg->error();
-		} else {
-			system->x = cg->solveWithGuess(b, system->x);
-			iterations = cg->iterations();
-			error = cg->error();
-		}
-	}
-
 	/* CG Method custom compute*/
 	void Solver::CG_custom_compute()
 	{
 		logger.log(INFO, "CG_custom_compute(): called.");
+		jacobi_preconditioner_compute();
+		csr_compute();
 
-		if (options.sparse) {
-			// Calculate the diagonal matrix of preconditioner
-			inv_precond = new Eigen::VectorXd(sparse_system->n);
-			inv_precond->setOnes();
-			for (int k = 0; k < sparse_system->A.outerSize(); ++k) {
-				for (Eigen::SparseMatrix<double>::InnerIterator it(sparse_system->A, k); it; ++it) {
-					if (it.row() == it.col()) {
-						if (it.value() >= EPS) {
-							(*inv_precond)[it.row()] = 1.0 / it.value();
-						}
-					}
-				}
-			}
-		} else {
-			// Calculate the diagonal matrix of preconditioner
-			inv_precond = new Eigen::VectorXd(system->n);
-			(*inv_precond) = system->A.diagonal().array().inverse();
-			for (int i = 0; i < system->n; i++) {
-				if (system->A(i,i) < EPS) {
-					(*inv_precond)(i) = 1;
-				}
-			}
-		}
+		// The deflation space of a previous matrix is not valid for the new one
+		int n = (options.sparse) ? sparse_system->n : system->n;
+		deflation.W.resize(n, 0);
+		deflation.AW.resize(n, 0);
+		deflation.harvests = 0;
 	}
 
-	void Solver::CG_custom_solve(const Eigen::VectorXd &b)
+	void Solver::CG_custom_solve(const Eigen::VectorXd &b, Eigen::VectorXd &x)
 	{
 		if (!inv_precond) {
 			logger.log(ERROR, "CG_custom_solve(): called without a preconditioner.");
 			return;
 		}
 
+		if (options.deflation > 0) {
+			CG_deflated_solve(b, x);
+			return;
+		}
+
 		int cg_iter = 0;
-		double alpha, beta, rho, rho1, cg_error = options.itol + 1;
+		double alpha, beta, rho, rho1, rr, cg_error = tolerance + 1;
 
-		int n = (options.sparse) ? sparse_system->n : system->n;
-		Eigen::VectorXd &x = (options.sparse) ? sparse_system->x : system->x;
-		Eigen::VectorXd r;
-		if (options.sparse) {
-			r = b - sparse_system->A * x;
-		} else {
-			r = b - system->A * x;
+		int n = x.size();
+		Eigen::VectorXd r, p, q;
+		first_touch(r);
+		first_touch(p);
+		first_touch(q);
+
+		double bnorm = b.norm();
+		if (bnorm < EPS) {
+			x.setZero();
+			return;
+		}
+
+		// Every iteration makes three passes: the direction, the SpMV fused with p^T q, and the update
+		// of x and r fused with the dot products of the next iteration (z = M^-1 r is never stored)
+		spmv(x, q);
+		rho = jacobi_residual(b, q, r, rr);
+
+		while (cg_error > tolerance && cg_iter < n) {
+			cg_iter++;
+			beta = (cg_iter == 1) ? 0 : rho / rho1;
+			jacobi_direction(r, beta, p);
+			rho1 = rho;
+
+			alpha = rho / spmv_dot(p, q, &p);
+			rho = cg_update(alpha, p, q, x, r, rr);
+
+			// Check for convergence
+			cg_error = std::sqrt(rr) / bnorm;
 		}
-		Eigen::VectorXd z(n);
-		Eigen::VectorXd p(n);
-		Eigen::VectorXd q(n);
+
+		iterations = cg_iter;
+		error = cg_error;
+
+		// Values lower than itol should be considered as 0
+		prune_output_vector(x);
+	}
+
+	/* Deflated preconditioned CG (Saad et al.)
+	 * The search directions are kept A-orthogonal to the recycled space W, so the
+	 * smallest eigenvalues of M^-1 A that W approximates no longer slow down convergence.
+	 * The first search directions of the first solves after compute() refine W.
+	 */
+	void Solver::CG_deflated_solve(const Eigen::VectorXd &b, Eigen::VectorXd &x)
+	{
+		int cg_iter = 0;
+		double alpha, beta, rho, rho1, cg_error;
+
+		int n = x.size();
+		Eigen::VectorXd r(n), z(n), p(n), q(n);
+		int harvest_cols = (deflation.harvests < DEFLATION_HARVEST_SOLVES) ? options.deflation : 0;
+		Eigen::MatrixXd P(n, harvest_cols);
+		bool deflate = (deflation.W.cols() > 0);
 
 		double bnorm = b.norm();
 		if (bnorm < EPS) {
@@ -306,7 +343,18 @@ namespace spic {
 			return;
 		}
 
-		while (cg_error > options.itol && cg_iter < n) {
+		spmv(x, r);
+		r = b - r;
+
+		// Correct the initial guess so that the residual is orthogonal to W
+		if (deflate) {
+			Eigen::VectorXd mu = deflation.WtAW.solve(deflation.W.transpose() * r);
+			x += deflation.W * mu;
+			r -= deflation.AW * mu;
+		}
+		cg_error = r.norm() / bnorm;
+
+		while (cg_error > tolerance && cg_iter < n) {
 			cg_iter++;
 			z = r.cwiseProduct(*inv_precond); // subroutine
 			rho = r.dot(z);
@@ -319,12 +367,16 @@ namespace spic {
 			}
 			rho1 = rho;
 
-			if (options.sparse) { // subroutine
-				q = sparse_system->A*p;
-			} else {
-				q = system->A*p;
+			// Remove the components of p along W (in the A inner product)
+			if (deflate) {
+				p -= deflation.W * deflation.WtAW.solve(deflation.AW.transpose() * z);
+			}
+
+			spmv(p, q); // subroutine
+			if (cg_iter <= harvest_cols) {
+				P.col(cg_iter - 1) = p;
 			}
-			
+
 			alpha = rho / p.dot(q);
 			x += alpha*p;
 			r -= alpha*q;
@@ -336,8 +388,139 @@ namespace spic {
 		iterations = cg_iter;
 		error = cg_error;
 
+		if (harvest_cols > 0) {
+			deflation_harvest(P.leftCols(std::min(cg_iter, harvest_cols)));
+		}
+
+		// Values lower than itol should be considered as 0
+		prune_output_vector(x);
+	}
+
+	/* Refine the deflation space with Rayleigh-Ritz on span{W, P}:
+	 * the eigenvectors of the smallest eigenvalues of (Q^T A Q) y = theta (Q^T M Q) y,
+	 * where Q is an orthonormal basis of span{W, P}, become the new W
+	 */
+	void Solver::deflation_harvest(const Eigen::MatrixXd &P)
+	{
+		int n = P.rows();
+		deflation.harvests++;
+
+		Eigen::MatrixXd Z(n, deflation.W.cols() + P.cols());
+		Z << deflation.W, P;
+		if (Z.cols() == 0) {
+			return;
+		}
+		Z.colwise().normalize();
+
+		Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr(Z);
+		qr.setThreshold(EPS_BLOCK);
+		int rank = qr.rank();
+		Eigen::MatrixXd Q = qr.householderQ() * Eigen::MatrixXd::Identity(n, rank);
+
+		Eigen::MatrixXd AQ(n, rank);
+		Eigen::VectorXd aq(n);
+		for (int j = 0; j < rank; j++) {
+			spmv(Q.col(j), aq);
+			AQ.col(j) = aq;
+		}
+
+		Eigen::MatrixXd F = Q.transpose() * AQ;
+		F = (F + F.transpose()) / 2;
+		Eigen::MatrixXd G = Q.transpose() * inv_precond->cwiseInverse().asDiagonal() * Q;
+
+		Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::MatrixXd> es(F, G);
+		if (es.info() != Eigen::Success) {
+			logger.log(WARNING, "deflation_harvest(): Rayleigh-Ritz failed, keeping the previous deflation space.");
+			return;
+		}
+
+		// Eigenvalues are sorted in increasing order
+		int k = std::min(options.deflation, rank);
+		deflation.W = Q * es.eigenvectors().leftCols(k);
+		deflation.AW = AQ * es.eigenvectors().leftCols(k);
+		for (int j = 0; j < k; j++) {
+			double norm = deflation.W.col(j).norm();
+			deflation.W.col(j) /= norm;
+			deflation.AW.col(j) /= norm;
+		}
+
+		Eigen::MatrixXd WtAW = deflation.W.transpose() * deflation.AW;
+		deflation.WtAW.compute((WtAW + WtAW.transpose()) / 2);
+		if (deflation.WtAW.info() != Eigen::Success) {
+			logger.log(WARNING, "deflation_harvest(): W^T A W is not SPD, dropping the deflation space.");
+			deflation.W.resize(n, 0);
+			deflation.AW.resize(n, 0);
+		}
+	}
+
+	/* Block preconditioned CG (O'Leary) for multiple right-hand sides.
+	 * A single SpMV with the block of search directions serves all the columns of B.
+	 * If the block becomes (nearly) linearly dependent, the remaining work is
+	 * done column by column with CG_custom_solve. A is the dense or sparse matrix of the system.
+	 */
+	template <typename Matrix>
+	void Solver::CG_custom_solve(const Matrix &A, const Eigen::MatrixXd &B, Eigen::MatrixXd &X)
+	{
+		if (!inv_precond) {
+			logger.log(ERROR, "CG_custom_solve(): called without a preconditioner.");
+			return;
+		}
+
+		int cg_iter = 0;
+		double cg_error = tolerance + 1;
+
+		int n = A.rows();
+		int k = B.cols();
+		Eigen::VectorXd bnorm = B.colwise().norm().transpose();
+		auto column_solve = [this](const Eigen::VectorXd &b, Eigen::VectorXd &x) { CG_custom_solve(b, x); return true; };
+
+		// Zero right-hand sides make the block rank deficient
+		if ((bnorm.array() < EPS).any()) {
+			solve_columns(B, X, column_solve);
+			return;
+		}
+
+		Eigen::MatrixXd R = B - A * X;
+		Eigen::MatrixXd Z = inv_precond->asDiagonal() * R;
+		Eigen::MatrixXd P = Z;
+		Eigen::MatrixXd Q(n, k);
+		Eigen::MatrixXd rho = Z.transpose() * R, rho1;
+		Eigen::MatrixXd alpha, beta;
+
+		while (cg_error > tolerance && cg_iter < n) {
+			cg_iter++;
+
+			Q = A * P; // subroutine
+
+			Eigen::LLT<Eigen::MatrixXd> pq(P.transpose() * Q);
+			if (pq.info() != Eigen::Success || pq.rcond() < EPS_BLOCK) {
+				logger.log(INFO, "CG_custom_solve(): block breakdown, continuing column by column.");
+				solve_columns(B, X, column_solve);
+				return;
+			}
+
+			alpha = pq.solve(rho);
+			X += P * alpha;
+			R -= Q * alpha;
+
+			// Check for convergence of the slowest column
+			cg_error = R.colwise().norm().transpose().cwiseQuotient(bnorm).maxCoeff();
+			if (cg_error <= tolerance) {
+				break;
+			}
+
+			Z = inv_precond->asDiagonal() * R;
+			rho1 = rho;
+			rho = Z.transpose() * R;
+			beta = rho1.llt().solve(rho);
+			P = Z + P * beta;
+		}
+
+		iterations = cg_iter;
+		error = cg_error;
+
 		// Values lower than itol should be considered as 0
-		prune_output_vector();
+		X = (X.array().abs() < options.itol).select(0, X);
 	}
 
 
@@ -346,59 +529,25 @@ namespace spic {
 	{
 		if (options.sparse) {
 			logger.log(INFO, "BiCG_integrated_compute(): called with a sparse system.");
-			sparse_bicg = new Eigen::BiCGSTAB<Eigen::SparseMatrix<double>>(sparse_system->A);
+			sparse_bicg = std::make_unique<Eigen::BiCGSTAB<Eigen::SparseMatrix<double>>>(sparse_system->A);
 			sparse_bicg->setTolerance(options.itol);
 		} else {
 			logger.log(INFO, "BiCG_integrated_compute(): called with a dense system.");
-			bicg = new Eigen::BiCGSTAB<Eigen::MatrixXd>(system->A);
+			bicg = std::make_unique<Eigen::BiCGSTAB<Eigen::MatrixXd>>(system->A);
 			bicg->setTolerance(options.itol);
 		}
 	}
 
-	void Solver::BiCG_integrated_solve(const Eigen::VectorXd &b)
-	{
-		if (options.sparse) {
-			sparse_system->x = sparse_bicg->solveWithGuess(b, sparse_system->x);
-			iterations = sparse_bicg->iterations();
-			error = sparse_bicg->error();
-		} else {
-			system->x = bicg->solveWithGuess(b, system->x);
-			iterations = bicg->iterations();
-			error = bicg->error();
-		}
-	}
-
 	/* BiCG Method custom implementation */
 	void Solver::BiCG_custom_compute()
 	{
 		logger.log(INFO, "BiCG_custom_compute(): called.");
-
-		if (options.sparse) {
-			// Calculate the diagonal matrix of preconditioner
-			inv_precond = new Eigen::VectorXd(sparse_system->n);
-			inv_precond->setOnes();
-			for (int k = 0; k < sparse_system->A.outerSize(); ++k) {
-				for (Eigen::SparseMatrix<double>::InnerIterator it(sparse_system->A, k); it; ++it) {
-					if (it.row() == it.col()) {
-						if (it.value() >= EPS) {
-							(*inv_precond)[it.row()] = 1.0 / it.value();
-						}
-					}
-				}
-			}
-		} else {
-			// Calculate the diagonal matrix of preconditioner
-			inv_precond = new Eigen::VectorXd(system->n);
-			(*inv_precond) = system->A.diagonal().array().inverse();
-			for (int i = 0; i < system->n; i++) {
-				if (system->A(i,i) < EPS) {
-					(*inv_precond)(i) = 1;
-				}
-			}
-		}
+		jacobi_preconditioner_compute();
+		csr_compute();
 	}
 
-	bool Solver::BiCG_custom_solve(const Eigen::VectorXd &b)
+	template <typename Matrix>
+	bool Solver::BiCG_custom_solve(const Matrix &A, const Eigen::VectorXd &b, Eigen::VectorXd &x)
 	{
 		if (!inv_precond) {
 			logger.log(ERROR, "BiCG_custom_solve(): called without a preconditioner.");
@@ -406,22 +555,16 @@ namespace spic {
 		}
 
 		int bicg_iter = 0;
-		double alpha, beta, omega, rho, rho1, bicg_error = options.itol + 1;
-
-		int n = (options.sparse) ? sparse_system->n : system->n;
-		Eigen::VectorXd &x = (options.sparse) ? sparse_system->x : system->x;
-		Eigen::VectorXd r;
-
-		if (options.sparse) {
-			r = b - sparse_system->A * x;
-		} else {
-			r = b - system->A * x;
-		}
+		double alpha, beta, omega, rho, rho1, rr, bicg_error = tolerance + 1;
 
-		Eigen::VectorXd r_tilda = r;
-		Eigen::VectorXd z(n), z_tilda(n);
-		Eigen::VectorXd p(n), p_tilda(n);
-		Eigen::VectorXd q(n), q_tilda(n);
+		int n = x.size();
+		Eigen::VectorXd r, r_tilda, p, p_tilda, q, q_tilda;
+		first_touch(r);
+		first_touch(r_tilda);
+		first_touch(p);
+		first_touch(p_tilda);
+		first_touch(q);
+		first_touch(q_tilda);
 
 		double bnorm = b.norm();
 		if (bnorm < EPS) {
@@ -429,89 +572,725 @@ namespace spic {
 			return true;
 		}
 
-		while (bicg_error > options.itol && bicg_iter < n) {
+		spmv(x, q);
+		rho = jacobi_residual(b, q, r, rr);
+		r_tilda = r;
 
-			bicg_iter++;
-			z = r.cwiseProduct(*inv_precond); // subroutine
-			z_tilda = r_tilda.cwiseProduct(*inv_precond); // subroutine
-			rho = r_tilda.dot(z);
+		while (bicg_error > tolerance && bicg_iter < n) {
 
+			bicg_iter++;
 			if (abs(rho) < EPS) {
 				return false;
 			}
 
-			if (bicg_iter == 1) {
-				p = z;
-				p_tilda = z_tilda;
-			} else {
-				beta = rho / rho1;
-				p = z + beta*p;
-				p_tilda = z_tilda + beta*p_tilda;
-			}
+			beta = (bicg_iter == 1) ? 0 : rho / rho1;
+			bicg_direction(r, r_tilda, beta, p, p_tilda);
 			rho1 = rho;
 
-			if (options.sparse) {
-				q = sparse_system->A * p; // subroutine
-				q_tilda = sparse_system->A.transpose() * p_tilda; // subroutine
-			} else {
-				q = system->A * p;
-				q_tilda = system->A.transpose() * p_tilda;
-			}
-
-			omega = p_tilda.dot(q);
+			omega = spmv_dot(p, q, &p_tilda);
+			spmv_transpose(A, p_tilda, q_tilda); // subroutine
 			if (abs(omega) < EPS) {
 				return false;
 			}
 
 			alpha = rho / omega;
-			x += alpha*p;
-			r -= alpha*q;
-			r_tilda -= alpha*q_tilda;
+			rho = bicg_update(alpha, p, q, q_tilda, x, r, r_tilda, rr);
 
-			bicg_error = r.norm() / bnorm;
+			bicg_error = std::sqrt(rr) / bnorm;
 		}
 
 		iterations = bicg_iter;
 		error = bicg_error;
 
 		// Values lower than itol should be considered as 0
-		prune_output_vector();
+		prune_output_vector(x);
 		
 		return true;
 	}
 
-	/* Wrapper functions */
+	/* BiCGSTAB Method custom implementation */
+	void Solver::BiCGSTAB_custom_compute()
+	{
+		logger.log(INFO, "BiCGSTAB_custom_compute(): called.");
+		jacobi_preconditioner_compute();
+		csr_compute();
+	}
 
-	/* Analyze is called before solve to either create the decomposition for direct methods
-	 * or the preconditioner for iterative methods 
+	/* Right preconditioned BiCGSTAB, unlike BiCG it needs no product with the transpose of A
+	 * On a breakdown the shadow residual is reset to the current residual and the iteration restarts
 	 */
-	void Solver::analyze()
+	bool Solver::BiCGSTAB_custom_solve(const Eigen::VectorXd &b, Eigen::VectorXd &x)
 	{
-		if (options.iter) {
-			compute();
-		} else {
-			if (!decompose()) {
-				logger.log(ERROR, "Exiting due to non-SPD MNA system");
-				exit(EXIT_FAILURE);
-			}
+		if (!inv_precond) {
+			logger.log(ERROR, "BiCGSTAB_custom_solve(): called without a preconditioner.");
+			return false;
 		}
-	}
 
-	/* Decompose is called before solve for direct methods */
-	bool Solver::decompose()
-	{
-		double start = omp_get_wtime();
-		bool res;
+		int bicgstab_iter = 0;
+		double alpha = 1, beta, omega = 1, rho, rho1 = 1, bicgstab_error;
 
-		switch (method)
-		{
-		case CHOLESKY:
-			if (options.custom) {
-				res = cholesky_custom_decompose();
-			} else {
-				res = cholesky_integrated_decompose();
+		int n = x.size();
+		Eigen::VectorXd r(n);
+
+		double bnorm = b.norm();
+		if (bnorm < EPS) {
+			x.setZero();
+			return true;
+		}
+
+		spmv(x, r);
+		r = b - r;
+
+		Eigen::VectorXd r_hat(n);
+		Eigen::VectorXd p = Eigen::VectorXd::Zero(n), v = Eigen::VectorXd::Zero(n);
+		Eigen::VectorXd y(n), s(n), z(n), t(n);
+		bicgstab_error = r.norm() / bnorm;
+
+		// The shadow residual r + A M^-1 r, as r alone is orthogonal to A M^-1 r when r is
+		// only in the rows with a zero diagonal (voltage sources, inductors) of an MNA matrix
+		auto new_shadow_residual = [&]() {
+			y = r.cwiseProduct(*inv_precond);
+			spmv(y, v);
+			r_hat = r + v;
+			v.setZero();
+		};
+		new_shadow_residual();
+
+		// Unlike BiCG it does not terminate in n steps, so it gets 2n as the integrated BiCGSTAB
+		while (bicgstab_error > tolerance && bicgstab_iter < 2 * n) {
+			bicgstab_iter++;
+			rho = r_hat.dot(r);
+
+			if (std::abs(rho) < EPS || std::abs(omega) < EPS) {
+				// Restart with a new shadow residual
+				new_shadow_residual();
+				rho = r_hat.dot(r);
+				p.setZero();
+				v.setZero();
+				alpha = rho1 = omega = 1;
 			}
-			if (!res) {
+
+			beta = (rho / rho1) * (alpha / omega);
+			p = r + beta * (p - omega * v);
+			rho1 = rho;
+
+			y = p.cwiseProduct(*inv_precond); // subroutine
+			spmv(y, v); // subroutine
+
+			double r_hat_v = r_hat.dot(v);
+			if (std::abs(r_hat_v) < EPS) {
+				return false;
+			}
+			alpha = rho / r_hat_v;
+			s = r - alpha * v;
+
+			// Early exit if the half step has converged
+			if (s.norm() / bnorm <= tolerance) {
+				x += alpha * y;
+				r = s;
+				bicgstab_error = s.norm() / bnorm;
+				break;
+			}
+
+			z = s.cwiseProduct(*inv_precond); // subroutine
+			spmv(z, t); // subroutine
+
+			double tt = t.squaredNorm();
+			omega = (tt < EPS) ? 0 : t.dot(s) / tt;
+			x += alpha * y + omega * z;
+			r = s - omega * t;
+
+			bicgstab_error = r.norm() / bnorm;
+		}
+
+		iterations = bicgstab_iter;
+		error = bicgstab_error;
+
+		// Values lower than itol should be considered as 0
+		prune_output_vector(x);
+
+		return true;
+	}
+
+	/* GMRES Method integrated implementation */
+	void Solver::GMRES_integrated_compute()
+	{
+		if (options.sparse) {
+			logger.log(INFO, "GMRES_integrated_compute(): called with a sparse system.");
+			sparse_gmres = std::make_unique<Eigen::GMRES<Eigen::SparseMatrix<double>>>(sparse_system->A);
+			sparse_gmres->setTolerance(options.itol);
+			sparse_gmres->set_restart(gmres_restart());
+		} else {
+			logger.log(INFO, "GMRES_integrated_compute(): called with a dense system.");
+			gmres = std::make_unique<Eigen::GMRES<Eigen::MatrixXd>>(system->A);
+			gmres->setTolerance(options.itol);
+			gmres->set_restart(gmres_restart());
+		}
+	}
+
+	/* GMRES Method custom implementation */
+	void Solver::GMRES_custom_compute()
+	{
+		logger.log(INFO, "GMRES_custom_compute(): called.");
+		jacobi_preconditioner_compute();
+		csr_compute();
+	}
+
+	/* Right preconditioned GMRES(m) with modified Gram-Schmidt orthogonalization
+	 * The least squares problem is solved incrementally with Givens rotations,
+	 * so the residual norm is known in every iteration without computing x
+	 */
+	bool Solver::GMRES_custom_solve(const Eigen::VectorXd &b, Eigen::VectorXd &x)
+	{
+		if (!inv_precond) {
+			logger.log(ERROR, "GMRES_custom_solve(): called without a preconditioner.");
+			return false;
+		}
+
+		int m = gmres_restart();
+		int gmres_iter = 0;
+		double beta, gmres_error;
+
+		int n = x.size();
+		Eigen::VectorXd r(n), w(n);
+
+		Eigen::MatrixXd V(n, m + 1); // Orthonormal basis of the Krylov subspace
+		Eigen::MatrixXd H(m + 1, m); // Upper Hessenberg matrix, triangularized in place
+		Eigen::VectorXd g(m + 1);    // Rotated right-hand side of the least squares problem
+		Eigen::VectorXd cs(m), sn(m); // Givens rotations
+
+		double bnorm = b.norm();
+		if (bnorm < EPS) {
+			x.setZero();
+			return true;
+		}
+
+		spmv(x, r);
+		r = b - r;
+		beta = r.norm();
+		gmres_error = beta / bnorm;
+
+		while (gmres_error > tolerance && gmres_iter < n) {
+			V.col(0) = r / beta;
+			g.setZero();
+			g(0) = beta;
+			H.setZero();
+
+			int k = 0;
+			while (k < m && gmres_iter < n) {
+				gmres_iter++;
+
+				// w = A * M^-1 * v_k
+				spmv(V.col(k).cwiseProduct(*inv_precond), w); // subroutine
+
+				// Modified Gram-Schmidt
+				for (int i = 0; i <= k; i++) {
+					H(i,k) = w.dot(V.col(i));
+					w -= H(i,k) * V.col(i);
+				}
+				H(k+1,k) = w.norm();
+
+				// On a (lucky) breakdown the Krylov subspace contains the solution
+				bool breakdown = (H(k+1,k) <= EPS);
+				if (!breakdown) {
+					V.col(k+1) = w / H(k+1,k);
+				}
+
+				// Apply the previous rotations to the new column of H
+				for (int i = 0; i < k; i++) {
+					double tmp = cs(i) * H(i,k) + sn(i) * H(i+1,k);
+					H(i+1,k) = -sn(i) * H(i,k) + cs(i) * H(i+1,k);
+					H(i,k) = tmp;
+				}
+
+				// Compute the rotation that eliminates H(k+1,k)
+				double denom = std::hypot(H(k,k), H(k+1,k));
+				if (denom < EPS) {
+					return false;
+				}
+				cs(k) = H(k,k) / denom;
+				sn(k) = H(k+1,k) / denom;
+				H(k,k) = denom;
+				H(k+1,k) = 0;
+				g(k+1) = -sn(k) * g(k);
+				g(k) = cs(k) * g(k);
+
+				k++;
+				gmres_error = std::abs(g(k)) / bnorm;
+				if (gmres_error <= tolerance || breakdown) {
+					break;
+				}
+			}
+
+			// Solve the k x k triangular system and update x = x + M^-1 * V * y
+			Eigen::VectorXd y = H.topLeftCorner(k, k).triangularView<Eigen::Upper>().solve(g.head(k));
+			x += (V.leftCols(k) * y).cwiseProduct(*inv_precond);
+
+			// Restart with the true residual
+			spmv(x, r);
+			r = b - r;
+			beta = r.norm();
+			gmres_error = beta / bnorm;
+		}
+
+		iterations = gmres_iter;
+		error = gmres_error;
+
+		// Values lower than itol should be considered as 0
+		prune_output_vector(x);
+
+		return true;
+	}
+
+	/* Mixed precision decomposition: factor a single precision copy of A
+	 * The double precision A is kept intact for the residuals of the iterative refinement
+	 */
+	bool Solver::mixed_decompose()
+	{
+		mixed_fallback = false;
+
+		if (method == LU) {
+			if (options.sparse) {
+				logger.log(INFO, "mixed_decompose(): single precision LU of a sparse system.");
+				sparse_lu_f = std::make_unique<Eigen::SparseLU<Eigen::SparseMatrix<float>>>(sparse_system->A.cast<float>());
+				if (sparse_lu_f->info() != Eigen::Success) {
+					logger.log(WARNING, "mixed_decompose(): single precision LU failed, using double precision.");
+					mixed_fallback = true;
+				}
+			} else {
+				logger.log(INFO, "mixed_decompose(): single precision LU of a dense system.");
+				lu_f = std::make_unique<Eigen::PartialPivLU<Eigen::MatrixXf>>(system->A.cast<float>());
+			}
+		} else {
+			if (options.sparse) {
+				logger.log(INFO, "mixed_decompose(): single precision cholesky of a sparse system.");
+				sparse_cholesky_f = std::make_unique<Eigen::SimplicialLLT<Eigen::SparseMatrix<float>, Eigen::Lower, Eigen::COLAMDOrdering<int>>>(sparse_system->A.cast<float>());
+				if (sparse_cholesky_f->info() != Eigen::Success) {
+					logger.log(WARNING, "mixed_decompose(): single precision cholesky failed, using double precision.");
+					mixed_fallback = true;
+				}
+			} else {
+				logger.log(INFO, "mixed_decompose(): single precision cholesky of a dense system.");
+				cholesky_f = std::make_unique<Eigen::LLT<Eigen::MatrixXf>>(system->A.cast<float>());
+				if (cholesky_f->info() != Eigen::Success) {
+					logger.log(WARNING, "mixed_decompose(): single precision cholesky failed, using double precision.");
+					mixed_fallback = true;
+				}
+			}
+		}
+
+		if (mixed_fallback) {
+			perf_counter.mixed_fallbacks++;
+			return (method == LU) ? LU_integrated_decompose() : cholesky_integrated_decompose();
+		}
+		return true;
+	}
+
+	/* Mixed precision solve: the single precision solution is corrected with
+	 * x += A_f^-1 (b - A x) where the residuals are computed in double precision.
+	 * If the refinement stalls, A is factored in double precision and used from then on.
+	 * The factorizations and A are those of the storage in use, as bound by bind_mixed().
+	 */
+	template <typename FactorizationF, typename Factorization, typename Matrix>
+	void Solver::mixed_solve(std::unique_ptr<FactorizationF> &factorization_f, std::unique_ptr<Factorization> &factorization,
+							 const Matrix &A, const Eigen::MatrixXd &B, Eigen::MatrixXd &X)
+	{
+		if (!mixed_fallback) {
+			Eigen::VectorXd bnorm = B.colwise().norm().transpose().cwiseMax(EPS);
+			Eigen::MatrixXd R;
+			double refine_error, prev_error = std::numeric_limits<double>::infinity();
+
+			X = Eigen::MatrixXf(factorization_f->solve(B.cast<float>())).cast<double>();
+			for (int step = 0; ; step++) {
+				R = B - A * X;
+
+				refine_error = R.colwise().norm().transpose().cwiseQuotient(bnorm).maxCoeff();
+				if (refine_error <= MIXED_REFINE_TOL) {
+					return;
+				}
+
+				// Stop if the error is not at least halved in each step
+				if (refine_error > 0.5 * prev_error || step == MIXED_MAX_REFINE) {
+					break;
+				}
+				prev_error = refine_error;
+
+				X += Eigen::MatrixXf(factorization_f->solve(R.cast<float>())).cast<double>();
+				perf_counter.refinement_steps++;
+			}
+
+			logger.log(WARNING, "mixed_solve(): iterative refinement stalled at relative residual "
+								+ std::to_string(refine_error) + ", using double precision.");
+			mixed_fallback = true;
+			perf_counter.mixed_fallbacks++;
+			successful_decomposition = (method == LU) ? LU_integrated_decompose() : cholesky_integrated_decompose();
+		}
+
+		X = factorization->solve(B);
+	}
+
+	/* Partition the graph of a sparse A into options.domains subdomains and a separator.
+	 * The BFS level structure of every connected component, rooted at a pseudo-peripheral
+	 * unknown, is cut into bands of equal size. Edges only connect unknowns of the same or
+	 * of adjacent levels, so a whole level between two bands separates them.
+	 */
+	bool Solver::schur_partition()
+	{
+		Eigen::SparseMatrix<double> &A = sparse_system->A;
+		int n = sparse_system->n;
+		int k = options.domains;
+
+		// Adjacency of the symmetrized pattern of A
+		std::vector<std::vector<int>> adjacency(n);
+		Eigen::VectorXd diagonal = Eigen::VectorXd::Zero(n);
+		for (int j = 0; j < A.outerSize(); j++) {
+			for (Eigen::SparseMatrix<double>::InnerIterator it(A, j); it; ++it) {
+				if (it.row() == it.col()) {
+					diagonal[it.row()] += it.value();
+				} else {
+					adjacency[it.row()].push_back(it.col());
+					adjacency[it.col()].push_back(it.row());
+				}
+			}
+		}
+
+		std::vector<int> visit(n, -1);
+		int run = 0;
+		auto bfs = [&](int root) {
+			std::vector<std::vector<int>> bfs_levels = {{root}};
+			visit[root] = run;
+			while (true) {
+				std::vector<int> next;
+				for (int u : bfs_levels.back()) {
+					for (int v : adjacency[u]) {
+						if (visit[v] != run) {
+							visit[v] = run;
+							next.push_back(v);
+						}
+					}
+				}
+				if (next.empty()) {
+					break;
+				}
+				bfs_levels.push_back(std::move(next));
+			}
+			run++;
+			return bfs_levels;
+		};
+
+		std::vector<std::vector<int>> levels;
+		for (int root = 0; root < n; root++) {
+			if (visit[root] != -1) {
+				continue;
+			}
+			// The last unknown reached from root is far from it, so its levels are narrow
+			int peripheral = bfs(root).back().front();
+			for (auto &level : bfs(peripheral)) {
+				levels.push_back(std::move(level));
+			}
+		}
+
+		// Cut the levels into k bands, the level at each cut becomes part of the separator
+		std::vector<int> part(n);
+		int domain = 0;
+		long count = 0;
+		bool prev_separator = false;
+		for (auto &level : levels) {
+			bool separator = (domain < k - 1 && !prev_separator && count >= (long)(domain + 1) * n / k);
+			if (separator) {
+				domain++;
+			}
+			for (int u : level) {
+				part[u] = (separator) ? k : domain;
+			}
+			prev_separator = separator;
+			count += level.size();
+		}
+
+		// An unknown with a zero diagonal (voltage source or inductor current) keeps the interior block
+		// nonsingular only together with one of its nodes, so it stays in its band if one of them is
+		// there too. Its nodes are in its band or in the separator, and if all are in the separator so is it.
+		std::vector<int> zero_diagonal;
+		for (int u = 0; u < n; u++) {
+			if (diagonal[u] == 0 && part[u] < k
+				&& std::none_of(adjacency[u].begin(), adjacency[u].end(), [&](int v) { return part[v] == part[u]; })) {
+				zero_diagonal.push_back(u);
+			}
+		}
+		for (int u : zero_diagonal) {
+			part[u] = k;
+		}
+
+		schur.interiors.assign(k, std::vector<int>());
+		schur.separator.clear();
+		for (int u = 0; u < n; u++) {
+			if (part[u] < k) {
+				schur.interiors[part[u]].push_back(u);
+			} else {
+				schur.separator.push_back(u);
+			}
+		}
+		std::erase_if(schur.interiors, [](const std::vector<int> &interior) { return interior.empty(); });
+
+		logger.log(INFO, "schur_partition(): " + std::to_string(schur.interiors.size()) + " subdomains and "
+						 + std::to_string(schur.separator.size()) + " separator unknowns.");
+
+		if (schur.interiors.size() < 2) {
+			logger.log(WARNING, "schur_partition(): the system can not be split into subdomains.");
+			return false;
+		}
+
+		// A band cut of a planar grid separates O(sqrt(n)) unknowns, and the dense Schur complement
+		// with its factorization take 2 m^2 doubles
+		long available = sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+		long max_separator = std::min<long>(SCHUR_SEPARATOR_SCALE * std::sqrt((double)n),
+											std::sqrt(SCHUR_MEMORY_FRACTION * available / (2 * sizeof(double))));
+		if (schur.separator.size() > max_separator) {
+			logger.log(WARNING, "schur_partition(): the separator is larger than "
+								+ std::to_string(max_separator) + " unknowns.");
+			return false;
+		}
+		return true;
+	}
+
+	/* Factor the subdomain interiors concurrently, then assemble and factor the dense
+	 * Schur complement of the separator S = A_SS - sum(A_SI A_II^-1 A_IS)
+	 */
+	bool Solver::schur_decompose()
+	{
+		schur.active = false;
+
+		if (!schur_partition()) {
+			return false;
+		}
+
+		Eigen::SparseMatrix<double> &A = sparse_system->A;
+		int n = sparse_system->n;
+		int k = schur.interiors.size();
+		int m = schur.separator.size();
+
+		// Subdomain (k for the separator) and local index of every unknown
+		std::vector<int> part(n, k), local(n);
+		for (int d = 0; d < k; d++) {
+			for (int i = 0; i < schur.interiors[d].size(); i++) {
+				part[schur.interiors[d][i]] = d;
+				local[schur.interiors[d][i]] = i;
+			}
+		}
+		for (int i = 0; i < m; i++) {
+			local[schur.separator[i]] = i;
+		}
+
+		// Split A into its blocks, A_SS goes directly to S
+		std::vector<std::vector<Eigen::Triplet<double>>> t_II(k), t_IS(k), t_SI(k);
+		Eigen::MatrixXd S = Eigen::MatrixXd::Zero(m, m);
+		for (int j = 0; j < A.outerSize(); j++) {
+			for (Eigen::SparseMatrix<double>::InnerIterator it(A, j); it; ++it) {
+				int pr = part[it.row()], pc = part[it.col()];
+				if (pr < k && pc < k) {
+					t_II[pr].emplace_back(local[it.row()], local[it.col()], it.value());
+				} else if (pr < k) {
+					t_IS[pr].emplace_back(local[it.row()], local[it.col()], it.value());
+				} else if (pc < k) {
+					t_SI[pc].emplace_back(local[it.row()], local[it.col()], it.value());
+				} else {
+					S(local[it.row()], local[it.col()]) += it.value();
+				}
+			}
+		}
+
+		schur.lu.clear();
+		schur.cholesky.clear();
+		schur.lu.resize(k);
+		schur.cholesky.resize(k);
+		schur.A_II.resize(k);
+		schur.A_IS.resize(k);
+		schur.A_SI.resize(k);
+
+		bool res = true;
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int d = 0; d < k; d++) {
+			int n_d = schur.interiors[d].size();
+
+			schur.A_II[d].resize(n_d, n_d);
+			schur.A_II[d].setFromTriplets(t_II[d].begin(), t_II[d].end());
+			schur.A_IS[d].resize(n_d, m);
+			schur.A_IS[d].setFromTriplets(t_IS[d].begin(), t_IS[d].end());
+			schur.A_SI[d].resize(m, n_d);
+			schur.A_SI[d].setFromTriplets(t_SI[d].begin(), t_SI[d].end());
+
+			bool factored;
+			if (method == CHOLESKY) {
+				schur.cholesky[d] = std::make_unique<Eigen::SimplicialLLT<Eigen::SparseMatrix<double>, Eigen::Lower, Eigen::COLAMDOrdering<int>>>(schur.A_II[d]);
+				factored = (schur.cholesky[d]->info() == Eigen::Success);
+			} else {
+				schur.lu[d] = std::make_unique<Eigen::SparseLU<Eigen::SparseMatrix<double>>>(schur.A_II[d]);
+				factored = (schur.lu[d]->info() == Eigen::Success);
+			}
+			if (!factored) {
+				#pragma omp atomic write
+				res = false;
+				continue;
+			}
+
+			// Only the separator unknowns coupled to the subdomain contribute to S
+			std::vector<int> coupling;
+			for (int j = 0; j < m; j++) {
+				if (schur.A_IS[d].col(j).nonZeros() > 0) {
+					coupling.push_back(j);
+				}
+			}
+
+			for (int c = 0; c < coupling.size(); c += SCHUR_RHS_BLOCK) {
+				int cols = std::min<int>(SCHUR_RHS_BLOCK, coupling.size() - c);
+				Eigen::MatrixXd R(n_d, cols);
+				for (int j = 0; j < cols; j++) {
+					R.col(j) = schur.A_IS[d].col(coupling[c + j]);
+				}
+				Eigen::MatrixXd C = schur.A_SI[d] * schur_interior_solve(d, R);
+
+				#pragma omp critical
+				for (int j = 0; j < cols; j++) {
+					S.col(coupling[c + j]) -= C.col(j);
+				}
+			}
+		}
+
+		if (!res) {
+			logger.log(WARNING, "schur_decompose(): the factorization of a subdomain failed.");
+			return false;
+		}
+
+		if (method == CHOLESKY) {
+			schur.S_cholesky.compute(S);
+			if (schur.S_cholesky.info() != Eigen::Success) {
+				logger.log(WARNING, "schur_decompose(): the Schur complement is not SPD.");
+				return false;
+			}
+		} else {
+			schur.S_lu.compute(S);
+		}
+
+		schur.active = true;
+		return true;
+	}
+
+	Eigen::MatrixXd Solver::schur_interior_solve(int d, const Eigen::MatrixXd &B)
+	{
+		if (method == CHOLESKY) {
+			return schur.cholesky[d]->solve(B);
+		} else {
+			return schur.lu[d]->solve(B);
+		}
+	}
+
+	/* Block elimination with the factored subdomains, where the interiors are solved concurrently
+	 *  - x_S = S^-1 (b_S - sum(A_SI A_II^-1 b_I))
+	 *  - x_I = A_II^-1 (b_I - A_IS x_S)
+	 */
+	void Solver::schur_solve(const Eigen::MatrixXd &B, Eigen::MatrixXd &X)
+	{
+		int k = schur.interiors.size();
+		int m = schur.separator.size();
+		std::vector<Eigen::MatrixXd> Y(k);
+
+		Eigen::MatrixXd G(m, B.cols());
+		for (int i = 0; i < m; i++) {
+			G.row(i) = B.row(schur.separator[i]);
+		}
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int d = 0; d < k; d++) {
+			Eigen::MatrixXd B_d(schur.interiors[d].size(), B.cols());
+			for (int i = 0; i < schur.interiors[d].size(); i++) {
+				B_d.row(i) = B.row(schur.interiors[d][i]);
+			}
+			Y[d] = schur_interior_solve(d, B_d);
+			Eigen::MatrixXd C = schur.A_SI[d] * Y[d];
+
+			#pragma omp critical
+			G -= C;
+		}
+
+		Eigen::MatrixXd X_S = (method == CHOLESKY) ? Eigen::MatrixXd(schur.S_cholesky.solve(G))
+												   : Eigen::MatrixXd(schur.S_lu.solve(G));
+
+		X.resize(B.rows(), B.cols());
+		for (int i = 0; i < m; i++) {
+			X.row(schur.separator[i]) = X_S.row(i);
+		}
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int d = 0; d < k; d++) {
+			Y[d] -= schur_interior_solve(d, schur.A_IS[d] * X_S);
+			for (int i = 0; i < schur.interiors[d].size(); i++) {
+				X.row(schur.interiors[d][i]) = Y[d].row(i);
+			}
+		}
+	}
+
+	/* Wrapper functions */
+
+	/* Analyze is called before solve to either create the decomposition for direct methods
+	 * or the preconditioner for iterative methods 
+	 */
+	void Solver::analyze()
+	{
+		// The factorization of the previous matrix is freed before the new one is allocated
+		release();
+
+		if (options.scale) {
+			equilibrate();
+		}
+
+		if (options.iter) {
+			tolerance = options.itol;
+			compute();
+		} else {
+			if (!decompose()) {
+				logger.log(ERROR, "Exiting due to non-SPD MNA system");
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		bind_solve();
+	}
+
+	/* Decompose is called before solve for direct methods */
+	bool Solver::decompose()
+	{
+		double start = omp_get_wtime();
+		bool res;
+
+		if (options.mixed) {
+			res = mixed_decompose();
+			successful_decomposition = res;
+			perf_counter.secs_in_decompose_calls += omp_get_wtime() - start;
+			perf_counter.decompose_calls++;
+			return res;
+		}
+
+		if (options.sparse && options.domains > 1) {
+			res = schur_decompose();
+			if (res) {
+				successful_decomposition = true;
+				perf_counter.secs_in_decompose_calls += omp_get_wtime() - start;
+				perf_counter.decompose_calls++;
+				return true;
+			}
+			logger.log(WARNING, "decompose(): domain decomposition failed, using a single factorization.");
+		}
+
+		switch (method)
+		{
+		case CHOLESKY:
+			if (options.custom) {
+				res = cholesky_custom_decompose();
+			} else {
+				res = cholesky_integrated_decompose();
+			}
+			if (!res) {
 				return false;
 			} else {
 				break;
@@ -555,6 +1334,20 @@ namespace spic {
 				CG_integrated_compute();
 			}
 			break;
+		case GMRES:
+			if (options.custom) {
+				GMRES_custom_compute();
+			} else {
+				GMRES_integrated_compute();
+			}
+			break;
+		case BiCGSTAB:
+			if (options.custom) {
+				BiCGSTAB_custom_compute();
+			} else {
+				BiCG_integrated_compute();
+			}
+			break;
 		default:
 			logger.log(ERROR, "compute(): Invalid method.");
 			exit(1);
@@ -567,83 +1360,742 @@ namespace spic {
 	/* solve() is called with a b to solve the system
 	 *  - For iterative methods solve() must be called after compute()
 	 *  - For direct methods solve() must be called after decompose()
+	 * If analyze() equilibrated A, b is scaled before and x is unscaled after the solve
 	 */
 	void Solver::solve(const Eigen::VectorXd &b)
 	{
 		double start = omp_get_wtime();
-		bool res;
+
+		if (scaling.active) {
+			Eigen::VectorXd &x = (options.sparse) ? sparse_system->x : system->x;
+			x = x.cwiseQuotient(scaling.col);
+			solve_system(b.cwiseProduct(scaling.row));
+			x = x.cwiseProduct(scaling.col);
+		} else {
+			solve_system(b);
+		}
+
+		perf_counter.secs_in_solve_calls += omp_get_wtime() - start;
+		perf_counter.solve_calls++;
+	}
+
+	/* Solve A x = b with the bound backend, the result is stored in the system's x vector */
+	void Solver::solve_system(const Eigen::VectorXd &b)
+	{
+		if (!solve_fn) {
+			logger.log(ERROR, "solve(): called before analyze().");
+			return;
+		}
+
+		if (!solve_fn(b)) {
+			logger.log(ERROR, std::string(method_names[method]) + "_custom_solve(): failed.");
+		}
+
+		if (options.iter) {
+			logger.log(INFO, std::string(method_names[method]) + ": Error was " + std::to_string(error) + " in "
+									+ std::to_string(iterations) + " Iterations: ");
+			perf_counter.iterations += iterations;
+		}
+	}
+
+	/* solve() with a block of right-hand sides, the solutions are stored in the columns of X
+	 *  - X is used as the initial guess of iterative methods, so it must have the shape of B
+	 *  - The system's x vector is left untouched
+	 */
+	void Solver::solve(const Eigen::MatrixXd &B, Eigen::MatrixXd &X)
+	{
+		double start = omp_get_wtime();
+
+		if (scaling.active) {
+			if (X.rows() == B.rows()) {
+				X = scaling.col.cwiseInverse().asDiagonal() * X;
+			}
+			solve_system(scaling.row.asDiagonal() * B, X);
+			X = scaling.col.asDiagonal() * X;
+		} else {
+			solve_system(B, X);
+		}
+
+		perf_counter.secs_in_solve_calls += omp_get_wtime() - start;
+		perf_counter.block_solve_calls++;
+		perf_counter.block_solve_rhs += B.cols();
+	}
+
+	/* Convergence threshold of the next solves of an iterative method, relative to ||b|| like ITOL.
+	 * The Eigen solvers take it at their next solve, and analyze() sets it back to ITOL.
+	 */
+	void Solver::set_tolerance(double tol)
+	{
+		tolerance = tol;
+	}
+
+	/* Several threads may solve against one factorization of a direct method at once, as its solves
+	 * only read it. The iterative methods write their iterations and error (the custom ones also their
+	 * work vectors) in the solver, and mixed precision may replace its factorization on a fallback.
+	 */
+	bool Solver::concurrent_solves()
+	{
+		return !options.iter && !options.mixed;
+	}
+
+	/* solve() of a block that can run concurrently with the other concurrent_solve() calls of the
+	 * solver, if concurrent_solves() is true. The perf counters are left to the caller.
+	 */
+	void Solver::concurrent_solve(const Eigen::MatrixXd &B, Eigen::MatrixXd &X)
+	{
+		if (scaling.active) {
+			block_solve_fn(scaling.row.asDiagonal() * B, X);
+			X = scaling.col.asDiagonal() * X;
+		} else {
+			block_solve_fn(B, X);
+		}
+	}
+
+	void Solver::solve_system(const Eigen::MatrixXd &B, Eigen::MatrixXd &X)
+	{
+		if (!block_solve_fn) {
+			logger.log(ERROR, "solve(): called before analyze().");
+			return;
+		}
+
+		if (!block_solve_fn(B, X)) {
+			logger.log(ERROR, std::string(method_names[method]) + "_custom_solve(): failed.");
+		}
+
+		if (options.iter) {
+			logger.log(INFO, "Block " + std::string(method_names[method]) + ": Error was " + std::to_string(error) + " in "
+									+ std::to_string(iterations) + " Iterations: ");
+			perf_counter.iterations += iterations;
+		}
+	}
+
+	/* Free the factorization, Krylov solver and preconditioner of the previous analyze() */
+	void Solver::release()
+	{
+		solve_fn = nullptr;
+		block_solve_fn = nullptr;
+
+		perm.reset();
+		inv_precond.reset();
+		lu.reset();
+		sparse_lu.reset();
+		cholesky.reset();
+		sparse_cholesky.reset();
+		sparse_cholesky_ooc.reset();
+		cg.reset();
+		sparse_cg.reset();
+		bicg.reset();
+		sparse_bicg.reset();
+		gmres.reset();
+		sparse_gmres.reset();
+		lu_f.reset();
+		sparse_lu_f.reset();
+		cholesky_f.reset();
+		sparse_cholesky_f.reset();
+		schur.lu.clear();
+		schur.cholesky.clear();
+		schur.active = false;
+	}
+
+	/* x = A^-1 b with a factorization of the dense or sparse A, which analyze() has checked */
+	template <typename Factorization>
+	void Solver::bind_direct(Factorization &factorization, Eigen::VectorXd &x)
+	{
+		solve_fn = [&factorization, &x](const Eigen::VectorXd &b) { x = factorization.solve(b); return true; };
+		block_solve_fn = [&factorization](const Eigen::MatrixXd &B, Eigen::MatrixXd &X) { X = factorization.solve(B); return true; };
+	}
+
+	/* Eigen Krylov solver of the dense or sparse A, x (or X) is the initial guess */
+	template <typename Krylov>
+	void Solver::bind_krylov(Krylov &krylov, Eigen::VectorXd &x)
+	{
+		solve_fn = [this, &krylov, &x](const Eigen::VectorXd &b) {
+			krylov.setTolerance(tolerance);
+			x = krylov.solveWithGuess(b, x);
+			iterations = krylov.iterations();
+			error = krylov.error();
+			return true;
+		};
+		block_solve_fn = [this, &krylov](const Eigen::MatrixXd &B, Eigen::MatrixXd &X) {
+			krylov.setTolerance(tolerance);
+			X = krylov.solveWithGuess(B, X);
+			iterations = krylov.iterations();
+			error = krylov.error();
+			return true;
+		};
+	}
+
+	/* The factorizations are bound by their owners, as the double precision one is only built on a fallback */
+	template <typename FactorizationF, typename Factorization, typename Matrix>
+	void Solver::bind_mixed(std::unique_ptr<FactorizationF> &factorization_f, std::unique_ptr<Factorization> &factorization,
+							const Matrix &A, Eigen::VectorXd &x)
+	{
+		solve_fn = [this, &factorization_f, &factorization, &A, &x](const Eigen::VectorXd &b) {
+			Eigen::MatrixXd X = x;
+			mixed_solve(factorization_f, factorization, A, b, X);
+			x = X;
+			return true;
+		};
+		block_solve_fn = [this, &factorization_f, &factorization, &A](const Eigen::MatrixXd &B, Eigen::MatrixXd &X) {
+			mixed_solve(factorization_f, factorization, A, B, X);
+			return true;
+		};
+	}
+
+	/* Select the solve functions of the method, the storage and the implementation once per analyze().
+	 * Every function is bound to the matrix, the factorization (or Krylov solver) and the x of the
+	 * storage in use, so no backend checks options.sparse in a solve.
+	 */
+	void Solver::bind_solve()
+	{
+		Eigen::VectorXd &x = (options.sparse) ? sparse_system->x : system->x;
+
+		if (options.mixed) {
+			if (method == LU && options.sparse) {
+				bind_mixed(sparse_lu_f, sparse_lu, sparse_system->A, x);
+			} else if (method == LU) {
+				bind_mixed(lu_f, lu, system->A, x);
+			} else if (options.sparse) {
+				bind_mixed(sparse_cholesky_f, sparse_cholesky, sparse_system->A, x);
+			} else {
+				bind_mixed(cholesky_f, cholesky, system->A, x);
+			}
+			return;
+		}
+
+		if (schur.active) {
+			solve_fn = [this, &x](const Eigen::VectorXd &b) {
+				Eigen::MatrixXd X;
+				schur_solve(b, X);
+				x = X;
+				return true;
+			};
+			block_solve_fn = [this](const Eigen::MatrixXd &B, Eigen::MatrixXd &X) { schur_solve(B, X); return true; };
+			return;
+		}
+
+		// Column by column solves of a block, for the custom iterative methods without a block version
+		auto bind_columns = [this, &x](auto column_solve) {
+			solve_fn = [column_solve, &x](const Eigen::VectorXd &b) { return column_solve(b, x); };
+			block_solve_fn = [this, column_solve](const Eigen::MatrixXd &B, Eigen::MatrixXd &X) {
+				return solve_columns(B, X, column_solve);
+			};
+		};
 
 		switch (method)
 		{
 		case CHOLESKY:
 			if (options.custom) {
-				cholesky_custom_solve(b);
+				solve_fn = [this](const Eigen::VectorXd &b) { cholesky_custom_solve(b); return true; };
+				block_solve_fn = [this](const Eigen::MatrixXd &B, Eigen::MatrixXd &X) { cholesky_custom_solve(B, X); return true; };
+			} else if (options.sparse && options.ooc > 0) {
+				bind_direct(*sparse_cholesky_ooc, x);
+			} else if (options.sparse) {
+				bind_direct(*sparse_cholesky, x);
 			} else {
-				cholesky_integrated_solve(b);
+				bind_direct(*cholesky, x);
 			}
 			break;
 		case LU:
 			if (options.custom) {
-				LU_custom_solve(b);
+				solve_fn = [this](const Eigen::VectorXd &b) { LU_custom_solve(b); return true; };
+				block_solve_fn = [this](const Eigen::MatrixXd &B, Eigen::MatrixXd &X) { LU_custom_solve(B, X); return true; };
+			} else if (options.sparse) {
+				bind_direct(*sparse_lu, x);
 			} else {
-				LU_integrated_solve(b);
+				bind_direct(*lu, x);
 			}
 			break;
 		case CG:
 			if (options.custom) {
-				CG_custom_solve(b);
+				solve_fn = [this, &x](const Eigen::VectorXd &b) { CG_custom_solve(b, x); return true; };
+				if (options.sparse) {
+					block_solve_fn = [this](const Eigen::MatrixXd &B, Eigen::MatrixXd &X) { CG_custom_solve(sparse_system->A, B, X); return true; };
+				} else {
+					block_solve_fn = [this](const Eigen::MatrixXd &B, Eigen::MatrixXd &X) { CG_custom_solve(system->A, B, X); return true; };
+				}
+			} else if (options.sparse) {
+				bind_krylov(*sparse_cg, x);
 			} else {
-				CG_integrated_solve(b);
+				bind_krylov(*cg, x);
 			}
-			logger.log(INFO, "CG: Error was " + std::to_string(error) + " in "
-									+ std::to_string(iterations) + " Iterations: ");
 			break;
 		case BiCG:
+			if (options.custom && options.sparse) {
+				bind_columns([this](const Eigen::VectorXd &b, Eigen::VectorXd &x) { return BiCG_custom_solve(sparse_system->A, b, x); });
+			} else if (options.custom) {
+				bind_columns([this](const Eigen::VectorXd &b, Eigen::VectorXd &x) { return BiCG_custom_solve(system->A, b, x); });
+			} else if (options.sparse) {
+				bind_krylov(*sparse_bicg, x);
+			} else {
+				bind_krylov(*bicg, x);
+			}
+			break;
+		case GMRES:
 			if (options.custom) {
-				res = BiCG_custom_solve(b);
-				if (!res) {
-					logger.log(ERROR, "BiCG_custom_solve(): failed.");
-				}
+				bind_columns([this](const Eigen::VectorXd &b, Eigen::VectorXd &x) { return GMRES_custom_solve(b, x); });
+			} else if (options.sparse) {
+				bind_krylov(*sparse_gmres, x);
 			} else {
-				BiCG_integrated_solve(b);
+				bind_krylov(*gmres, x);
+			}
+			break;
+		case BiCGSTAB:
+			if (options.custom) {
+				bind_columns([this](const Eigen::VectorXd &b, Eigen::VectorXd &x) { return BiCGSTAB_custom_solve(b, x); });
+			} else if (options.sparse) {
+				bind_krylov(*sparse_bicg, x);
+			} else {
+				bind_krylov(*bicg, x);
 			}
-
-			logger.log(INFO, "BiCG: Error was " + std::to_string(error) + " in "
-									+ std::to_string(iterations) + " Iterations: ");
 			break;
 		default:
-			logger.log(ERROR, "solve(): Invalid method.");
+			logger.log(ERROR, "bind_solve(): Invalid method.");
 			exit(1);
 		}
+	}
 
-		perf_counter.secs_in_solve_calls += omp_get_wtime() - start;
-		perf_counter.solve_calls++;
+	/* Iterative (Ruiz) equilibration of A in place. Every pass divides the rows and the columns
+	 * by the square roots of their max norms, until all the norms are close to 1. The conductances
+	 * and the unit couplings of the voltage sources end up in the same range. A symmetric A
+	 * stays symmetric, since its row and column norms are equal.
+	 */
+	void Solver::equilibrate()
+	{
+		double start = omp_get_wtime();
+		int n = (options.sparse) ? sparse_system->n : system->n;
+		Eigen::VectorXd row_max(n), col_max(n), r, c;
+		int pass;
+
+		scaling.row = Eigen::VectorXd::Ones(n);
+		scaling.col = Eigen::VectorXd::Ones(n);
+
+		for (pass = 0; pass < SCALING_MAX_PASSES; pass++) {
+			if (options.sparse) {
+				row_max.setZero();
+				col_max.setZero();
+				for (int k = 0; k < sparse_system->A.outerSize(); k++) {
+					for (Eigen::SparseMatrix<double>::InnerIterator it(sparse_system->A, k); it; ++it) {
+						row_max(it.row()) = std::max(row_max(it.row()), std::abs(it.value()));
+						col_max(it.col()) = std::max(col_max(it.col()), std::abs(it.value()));
+					}
+				}
+			} else {
+				row_max = system->A.cwiseAbs().rowwise().maxCoeff();
+				col_max = system->A.cwiseAbs().colwise().maxCoeff().transpose();
+			}
+
+			// Empty rows and columns are left as they are
+			row_max = (row_max.array() > EPS).select(row_max, 1.0);
+			col_max = (col_max.array() > EPS).select(col_max, 1.0);
+
+			double deviation = std::max((row_max.array() - 1).abs().maxCoeff(), (col_max.array() - 1).abs().maxCoeff());
+			if (deviation <= SCALING_TOL) {
+				break;
+			}
+
+			r = row_max.cwiseSqrt().cwiseInverse();
+			c = col_max.cwiseSqrt().cwiseInverse();
+			if (options.sparse) {
+				#pragma omp parallel for schedule(static)
+				for (int k = 0; k < sparse_system->A.outerSize(); k++) {
+					for (Eigen::SparseMatrix<double>::InnerIterator it(sparse_system->A, k); it; ++it) {
+						it.valueRef() *= r(it.row()) * c(k);
+					}
+				}
+			} else {
+				system->A.array().colwise() *= r.array();
+				system->A.array().rowwise() *= c.transpose().array();
+			}
+			scaling.row = scaling.row.cwiseProduct(r);
+			scaling.col = scaling.col.cwiseProduct(c);
+		}
+
+		scaling.active = true;
+		perf_counter.secs_in_scaling += omp_get_wtime() - start;
+		logger.log(INFO, "equilibrate(): " + std::to_string(pass) + " passes, row scales in ["
+						 + std::to_string(scaling.row.minCoeff()) + ", " + std::to_string(scaling.row.maxCoeff()) + "].");
 	}
-	
+
 	/* Make values less than the specified tolerance equal to zero */ 
-	void Solver::prune_output_vector()
+	void Solver::prune_output_vector(Eigen::VectorXd &x)
 	{
-		Eigen::VectorXd &x = (options.sparse) ? sparse_system->x : system->x;
-
 		assert(options.iter == true);
 
-		for (int i = 0; i < system->n; i++) {
+		for (int i = 0; i < x.size(); i++) {
 			if (std::abs(x(i)) < options.itol) {
 				x(i) = 0;
 			}
 		}
 	}
 
+	/* Calculate the diagonal (Jacobi) preconditioner of the custom iterative methods */
+	void Solver::jacobi_preconditioner_compute()
+	{
+		if (options.sparse) {
+			// Calculate the diagonal matrix of preconditioner
+			inv_precond = std::make_unique<Eigen::VectorXd>(sparse_system->n);
+			inv_precond->setOnes();
+			for (int k = 0; k < sparse_system->A.outerSize(); ++k) {
+				for (Eigen::SparseMatrix<double>::InnerIterator it(sparse_system->A, k); it; ++it) {
+					if (it.row() == it.col()) {
+						if (it.value() >= EPS) {
+							(*inv_precond)[it.row()] = 1.0 / it.value();
+						}
+					}
+				}
+			}
+		} else {
+			// Calculate the diagonal matrix of preconditioner
+			inv_precond = std::make_unique<Eigen::VectorXd>(system->n);
+			(*inv_precond) = system->A.diagonal().array().inverse();
+			for (int i = 0; i < system->n; i++) {
+				if (system->A(i,i) < EPS) {
+					(*inv_precond)(i) = 1;
+				}
+			}
+		}
+	}
+
+	/* Split the rows of A into one contiguous block per thread, with about the same non zeros in every block.
+	 * Every kernel of the custom iterative methods works on the rows (and vector entries) of its thread's
+	 * block, and the same blocks are used for the first touch of the data, so with OMP_PROC_BIND the
+	 * pages of a block are placed on the NUMA node of the thread that streams them. The blocks are dealt
+	 * round-robin over the team, so all of them are processed even if OpenMP delivers fewer threads
+	 * (OMP_DYNAMIC, OMP_THREAD_LIMIT or a solve inside an enclosing parallel region).
+	 */
+	void Solver::partition_compute()
+	{
+		int n = (options.sparse) ? sparse_system->n : system->n;
+		int threads = std::max(1, std::min(omp_get_max_threads(), n));
+		std::vector<long> row_nnz(n + 1, 0);
+
+		if (options.sparse) {
+			for (int k = 0; k < sparse_system->A.outerSize(); k++) {
+				for (Eigen::SparseMatrix<double>::InnerIterator it(sparse_system->A, k); it; ++it) {
+					row_nnz[it.row() + 1]++;
+				}
+			}
+		} else {
+			std::fill(row_nnz.begin() + 1, row_nnz.end(), n);
+		}
+		for (int i = 0; i < n; i++) {
+			row_nnz[i + 1] += row_nnz[i] + 1; // Count the vector entries of a row as well
+		}
+
+		row_partition.assign(threads + 1, n);
+		row_partition[0] = 0;
+		for (int t = 1, i = 0; t < threads; t++) {
+			long target = row_nnz[n] * t / threads;
+			while (i < n && row_nnz[i] < target) {
+				i++;
+			}
+			row_partition[t] = i;
+		}
+	}
+
+	/* Reallocate v so that the entries of every row block are first touched by the thread that owns
+	 * the block, the values of v are kept (or zeroed if v has not the size of the system)
+	 */
+	void Solver::first_touch(Eigen::VectorXd &v)
+	{
+		int n = row_partition.back();
+		Eigen::VectorXd placed(n); // Allocated but not touched
+		bool keep = (v.size() == n);
+
+		#pragma omp parallel num_threads(row_partition.size() - 1)
+		{
+			int blocks = row_partition.size() - 1;
+			for (int t = omp_get_thread_num(); t < blocks; t += omp_get_num_threads()) {
+				for (int i = row_partition[t]; i < row_partition[t + 1]; i++) {
+					placed(i) = (keep) ? v(i) : 0;
+				}
+			}
+		}
+		v.swap(placed);
+	}
+
+	/* Keep a row-major (CSR) copy of a sparse A, so that A * p is a gather over the rows of the copy
+	 * and A^T * p a gather over the columns of the column-major A.
+	 * The arrays of the copy are filled by the threads that own the rows, for the first touch placement.
+	 */
+	void Solver::csr_compute()
+	{
+		partition_compute();
+
+		if (options.sparse) {
+			Eigen::SparseMatrix<double, Eigen::RowMajor> csr_serial = sparse_system->A;
+			csr_serial.makeCompressed();
+
+			csr_A.resize(csr_serial.rows(), csr_serial.cols());
+			csr_A.resizeNonZeros(csr_serial.nonZeros()); // Allocated but not touched
+			std::copy(csr_serial.outerIndexPtr(), csr_serial.outerIndexPtr() + csr_serial.outerSize() + 1,
+					  csr_A.outerIndexPtr());
+
+			#pragma omp parallel num_threads(row_partition.size() - 1)
+			{
+				int blocks = row_partition.size() - 1;
+				for (int t = omp_get_thread_num(); t < blocks; t += omp_get_num_threads()) {
+					int begin = csr_serial.outerIndexPtr()[row_partition[t]];
+					int end = csr_serial.outerIndexPtr()[row_partition[t + 1]];
+					std::copy(csr_serial.innerIndexPtr() + begin, csr_serial.innerIndexPtr() + end, csr_A.innerIndexPtr() + begin);
+					std::copy(csr_serial.valuePtr() + begin, csr_serial.valuePtr() + end, csr_A.valuePtr() + begin);
+				}
+			}
+		}
+
+		first_touch((options.sparse) ? sparse_system->x : system->x);
+	}
+
+	/* Gather-only sparse matrix vector product, parallel over the outer dimension of M
+	 * For a row-major M this is M * p and for a column-major M this is M^T * p
+	 */
+	template <typename SparseMatrixType>
+	static void gather_spmv(const SparseMatrixType &M, const Eigen::VectorXd &p, Eigen::VectorXd &q)
+	{
+		q.resize(M.outerSize());
+
+		#pragma omp parallel for schedule(static)
+		for (int k = 0; k < M.outerSize(); k++) {
+			double sum = 0;
+			for (typename SparseMatrixType::InnerIterator it(M, k); it; ++it) {
+				sum += it.value() * p(it.index());
+			}
+			q(k) = sum;
+		}
+	}
+
+	/* q = A * p over the row blocks, fused with the dot product w^T q (if w is given) */
+	double Solver::spmv_dot(const Eigen::VectorXd &p, Eigen::VectorXd &q, const Eigen::VectorXd *w)
+	{
+		double dot = 0;
+
+		if (!options.sparse) {
+			q.noalias() = system->A * p;
+			return (w) ? w->dot(q) : 0;
+		}
+
+		q.resize(csr_A.rows());
+		const int *outer = csr_A.outerIndexPtr();
+		const int *inner = csr_A.innerIndexPtr();
+		const double *values = csr_A.valuePtr();
+
+		#pragma omp parallel num_threads(row_partition.size() - 1) reduction(+:dot)
+		{
+			int blocks = row_partition.size() - 1;
+			for (int t = omp_get_thread_num(); t < blocks; t += omp_get_num_threads()) {
+				for (int i = row_partition[t]; i < row_partition[t + 1]; i++) {
+					double sum = 0;
+					for (int k = outer[i]; k < outer[i + 1]; k++) {
+						sum += values[k] * p(inner[k]);
+					}
+					q(i) = sum;
+					if (w) {
+						dot += (*w)(i) * sum;
+					}
+				}
+			}
+		}
+		return dot;
+	}
+
+	/* q = A * p for the custom iterative methods */
+	void Solver::spmv(const Eigen::VectorXd &p, Eigen::VectorXd &q)
+	{
+		spmv_dot(p, q, nullptr);
+	}
+
+	/* Fused vector kernels of the custom CG and BiCG with the Jacobi preconditioner M, one pass each */
+
+	/* r = b - q, returns r^T M^-1 r and sets rr = r^T r */
+	double Solver::jacobi_residual(const Eigen::VectorXd &b, const Eigen::VectorXd &q, Eigen::VectorXd &r, double &rr)
+	{
+		const double *inv = inv_precond->data();
+		double rz = 0, rr_sum = 0;
+
+		#pragma omp parallel num_threads(row_partition.size() - 1) reduction(+:rz, rr_sum)
+		{
+			int blocks = row_partition.size() - 1;
+			for (int t = omp_get_thread_num(); t < blocks; t += omp_get_num_threads()) {
+				for (int i = row_partition[t]; i < row_partition[t + 1]; i++) {
+					double ri = b[i] - q[i];
+					r[i] = ri;
+					rr_sum += ri * ri;
+					rz += ri * ri * inv[i];
+				}
+			}
+		}
+		rr = rr_sum;
+		return rz;
+	}
+
+	/* p = M^-1 r + beta p */
+	void Solver::jacobi_direction(const Eigen::VectorXd &r, double beta, Eigen::VectorXd &p)
+	{
+		const double *inv = inv_precond->data();
+
+		#pragma omp parallel num_threads(row_partition.size() - 1)
+		{
+			int blocks = row_partition.size() - 1;
+			for (int t = omp_get_thread_num(); t < blocks; t += omp_get_num_threads()) {
+				for (int i = row_partition[t]; i < row_partition[t + 1]; i++) {
+					p[i] = inv[i] * r[i] + beta * p[i];
+				}
+			}
+		}
+	}
+
+	/* x += alpha p and r -= alpha q, returns r^T M^-1 r and sets rr = r^T r */
+	double Solver::cg_update(double alpha, const Eigen::VectorXd &p, const Eigen::VectorXd &q,
+							 Eigen::VectorXd &x, Eigen::VectorXd &r, double &rr)
+	{
+		const double *inv = inv_precond->data();
+		double rz = 0, rr_sum = 0;
+
+		#pragma omp parallel num_threads(row_partition.size() - 1) reduction(+:rz, rr_sum)
+		{
+			int blocks = row_partition.size() - 1;
+			for (int t = omp_get_thread_num(); t < blocks; t += omp_get_num_threads()) {
+				for (int i = row_partition[t]; i < row_partition[t + 1]; i++) {
+					x[i] += alpha * p[i];
+					double ri = r[i] - alpha * q[i];
+					r[i] = ri;
+					rr_sum += ri * ri;
+					rz += ri * ri * inv[i];
+				}
+			}
+		}
+		rr = rr_sum;
+		return rz;
+	}
+
+	/* p = M^-1 r + beta p and p_tilda = M^-1 r_tilda + beta p_tilda */
+	void Solver::bicg_direction(const Eigen::VectorXd &r, const Eigen::VectorXd &r_tilda, double beta,
+								Eigen::VectorXd &p, Eigen::VectorXd &p_tilda)
+	{
+		const double *inv = inv_precond->data();
+
+		#pragma omp parallel num_threads(row_partition.size() - 1)
+		{
+			int blocks = row_partition.size() - 1;
+			for (int t = omp_get_thread_num(); t < blocks; t += omp_get_num_threads()) {
+				for (int i = row_partition[t]; i < row_partition[t + 1]; i++) {
+					p[i] = inv[i] * r[i] + beta * p[i];
+					p_tilda[i] = inv[i] * r_tilda[i] + beta * p_tilda[i];
+				}
+			}
+		}
+	}
+
+	/* x += alpha p, r -= alpha q and r_tilda -= alpha q_tilda, returns r_tilda^T M^-1 r and sets rr = r^T r */
+	double Solver::bicg_update(double alpha, const Eigen::VectorXd &p, const Eigen::VectorXd &q,
+							   const Eigen::VectorXd &q_tilda, Eigen::VectorXd &x, Eigen::VectorXd &r,
+							   Eigen::VectorXd &r_tilda, double &rr)
+	{
+		const double *inv = inv_precond->data();
+		double rz = 0, rr_sum = 0;
+
+		#pragma omp parallel num_threads(row_partition.size() - 1) reduction(+:rz, rr_sum)
+		{
+			int blocks = row_partition.size() - 1;
+			for (int t = omp_get_thread_num(); t < blocks; t += omp_get_num_threads()) {
+				for (int i = row_partition[t]; i < row_partition[t + 1]; i++) {
+					x[i] += alpha * p[i];
+					double ri = r[i] - alpha * q[i];
+					double ri_tilda = r_tilda[i] - alpha * q_tilda[i];
+					r[i] = ri;
+					r_tilda[i] = ri_tilda;
+					rr_sum += ri * ri;
+					rz += ri_tilda * ri * inv[i];
+				}
+			}
+		}
+		rr = rr_sum;
+		return rz;
+	}
+
+	/* q = A^T * p for the custom iterative methods */
+	void Solver::spmv_transpose(const Eigen::SparseMatrix<double> &A, const Eigen::VectorXd &p, Eigen::VectorXd &q)
+	{
+		gather_spmv(A, p, q);
+	}
+
+	void Solver::spmv_transpose(const Eigen::MatrixXd &A, const Eigen::VectorXd &p, Eigen::VectorXd &q)
+	{
+		q.noalias() = A.transpose() * p;
+	}
+
+	/* Restart length of GMRES */
+	int Solver::gmres_restart()
+	{
+		return (options.restart > 0) ? options.restart : GMRES_DEFAULT_RESTART;
+	}
+
+	/* Solve the columns of B one at a time with column_solve(b, x) of a custom iterative method,
+	 * every column of X is the initial guess of its solve. The system's x vector is left untouched.
+	 */
+	template <typename ColumnSolve>
+	bool Solver::solve_columns(const Eigen::MatrixXd &B, Eigen::MatrixXd &X, ColumnSolve column_solve)
+	{
+		Eigen::VectorXd x;
+		int max_iterations = 0;
+		double max_error = 0;
+		bool res = true;
+
+		// The columns are copied into a vector placed like the system's x
+		first_touch(x);
+		for (int j = 0; j < B.cols(); j++) {
+			x = X.col(j);
+			res = column_solve(B.col(j), x) && res;
+			X.col(j) = x;
+			max_iterations = std::max(max_iterations, iterations);
+			max_error = std::max(max_error, error);
+		}
+
+		iterations = max_iterations;
+		error = max_error;
+		return res;
+	}
+
 	/* Dump performance counters to a file */
+	/* Accumulate the performance counters of a solver that worked on behalf of this one */
+	void Solver::add_perf_counters(const Solver &other)
+	{
+		perf_counter.secs_in_decompose_calls += other.perf_counter.secs_in_decompose_calls;
+		perf_counter.secs_in_compute_calls += other.perf_counter.secs_in_compute_calls;
+		perf_counter.secs_in_scaling += other.perf_counter.secs_in_scaling;
+		perf_counter.secs_in_solve_calls += other.perf_counter.secs_in_solve_calls;
+		perf_counter.decompose_calls += other.perf_counter.decompose_calls;
+		perf_counter.compute_calls += other.perf_counter.compute_calls;
+		perf_counter.solve_calls += other.perf_counter.solve_calls;
+		perf_counter.block_solve_calls += other.perf_counter.block_solve_calls;
+		perf_counter.block_solve_rhs += other.perf_counter.block_solve_rhs;
+		perf_counter.refinement_steps += other.perf_counter.refinement_steps;
+		perf_counter.mixed_fallbacks += other.perf_counter.mixed_fallbacks;
+		perf_counter.factorization_hits += other.perf_counter.factorization_hits;
+		perf_counter.factorization_misses += other.perf_counter.factorization_misses;
+		perf_counter.factorization_evictions += other.perf_counter.factorization_evictions;
+		perf_counter.iterations += other.perf_counter.iterations;
+	}
+
 	void Solver::dump_perf_counters(std::filesystem::path &filename, double g_time)
 	{
 		std::ofstream file(filename.string(), std::ofstream::out);
 		file << "secs_in_decompose:\t" << perf_counter.secs_in_decompose_calls << std::endl;
 		file << "secs_in_compute:\t" << perf_counter.secs_in_compute_calls << std::endl;
+		file << "secs_in_scaling:\t" << perf_counter.secs_in_scaling << std::endl;
 		file << "secs_in_solve:\t" << perf_counter.secs_in_solve_calls << std::endl;
 		file << "decompose_calls:\t" << perf_counter.decompose_calls << std::endl;
 		file << "compute_calls:\t" << perf_counter.compute_calls << std::endl;
 		file << "solve_calls:\t" << perf_counter.solve_calls << std::endl;
+		file << "block_solve_calls:\t" << perf_counter.block_solve_calls << std::endl;
+		file << "block_solve_rhs:\t" << perf_counter.block_solve_rhs << std::endl;
+		file << "refinement_steps:\t" << perf_counter.refinement_steps << std::endl;
+		file << "mixed_fallbacks:\t" << perf_counter.mixed_fallbacks << std::endl;
+		file << "factorization_cache_hits:\t" << perf_counter.factorization_hits << std::endl;
+		file << "factorization_cache_misses:\t" << perf_counter.factorization_misses << std::endl;
+		file << "factorization_cache_evictions:\t" << perf_counter.factorization_evictions << std::endl;
+		file << "iterations:\t" << perf_counter.iterations << std::endl;
 		file << "total_secs:\t" << g_time << std::endl;
 		file.close();
 	}
@@ -653,7 +2105,23 @@ std::ostream& operator<<(std::ostream &out, const spic::options_t &options) {
 	out << "\tCustom: " << (options.custom ? "Enabled" : "Disabled") << std::endl;
 	out << "\tSPD: "  << (options.spd ? "Enabled" : "Disabled") << std::endl;
 	out << "\tIter: " << (options.iter ? "Enabled" : "Disabled") << std::endl;
+	out << "\tMixed: " << (options.mixed ? "Enabled" : "Disabled") << std::endl;
+	out << "\tGMRES: " << (options.gmres ? "Enabled" : "Disabled") << std::endl;
+	out << "\tBiCGSTAB: " << (options.bicgstab ? "Enabled" : "Disabled") << std::endl;
+	out << "\tAutotune: " << (options.autotune ? "Enabled" : "Disabled") << std::endl;
+	out << "\tScale: " << (options.scale ? "Enabled" : "Disabled") << std::endl;
+	out << "\tDeflation: " << options.deflation << std::endl;
+	out << "\tPredictor: " << options.predictor << std::endl;
+	out << "\tDomains: " << options.domains << std::endl;
+	out << "\tOut of core budget (MB): " << options.ooc << std::endl;
+	out << "\tRestart: " << options.restart << std::endl;
 	out << "\tItol: " << options.itol << std::endl;
-	out << "\tTransient Method: "<< ((options.transient_method == spic::TR) ? "TR" : "BE") << std::endl;
+	out << "\tLTE tolerance: " << options.lte_tol << std::endl;
+	out << "\tParareal slices: " << options.parareal << std::endl;
+	out << "\tTransient jobs: " << options.tran_jobs << std::endl;
+	out << "\tFactorization cache budget (MB): " << options.fact_cache << std::endl;
+	out << "\tTransient Method: "<< ((options.transient_method == spic::TR) ? "TR" :
+										(options.transient_method == spic::GEAR) ? "GEAR" :
+										(options.transient_method == spic::EXP) ? "EXP" : "BE") << std::endl;
 	return out;
 }
\ No newline at end of file
@@ -145,14 +145,26 @@ namespace spic {
 	}
 
 	/*
-	 * Calculates the A = G + C / time_step matrix for a Transient Analysis run
+	 * Calculates the A = G + alpha * C matrix for a Transient Analysis run
 	 */
 	void MNASparseSystemTransient::create_tran_system(double time_step)
 	{
-		if (transient_method == BE) {
-			mna_sparse_system.A = G + C / time_step;
+		mna_sparse_system.A = G + C * tran_alpha(time_step);
+		dc_overwritten = true;
+	}
+
+	/*
+	 * Coefficient alpha of the transient matrix A = G + alpha * C of the method for a time step
+	 */
+	double MNASparseSystemTransient::tran_alpha(double time_step)
+	{
+		// The exponential method factors the Backward-Euler matrix as the shift of its Krylov subspace
+		if (transient_method == BE || transient_method == EXP) {
+			return 1 / time_step;
 		} else if (transient_method == TR) {
-			mna_sparse_system.A = G + C * (2 / time_step);
+			return 2 / time_step;
+		} else {
+			return 1.5 / time_step;
 		}
 	}
 
@@ -172,6 +184,15 @@ namespace spic {
 		mna_sparse_system.b = e_new + e_old - (G - C * (2.0 / time_step)) * mna_sparse_system.x;
 	}
 
+	/*
+	 * Update the b part of the Transient Equation for the second order Gear (BDF2) method,
+	 * x holds the solution of the previous step and x_prev the one before it
+	 */
+	void MNASparseSystemTransient::update_tran_system_gear(Eigen::VectorXd &e, Eigen::VectorXd &x_prev, double time_step)
+	{
+		mna_sparse_system.b = e + (C * (4 * mna_sparse_system.x - x_prev)) / (2 * time_step);
+	}
+
 	/* Adds capacitor stamps for the transient part (C) of the MNA system */
 	void MNASparseSystemTransient::add_capacitor_stamp(std::vector<Eigen::Triplet<double>> &triplets,
 													node_id_t node_positive, node_id_t node_negative, float value)
@@ -3,12 +3,19 @@
 #include <cassert>
 #include <ostream>
 #include <set>
+#include <algorithm>
+#include <climits>
+#include <omp.h>
+
+#include <unsupported/Eigen/MatrixFunctions>
 
 #include "transient.h"
 #include "commands.h"
 #include "solver.h"
 #include "netlist.h"
 #include "node_table.h"
+#include "factorization_cache.h"
+#include "scenario.h"
 
 namespace spic {
 	/*******************************************************************/
@@ -70,20 +77,306 @@ namespace spic {
 	}
 
 	double TransientSpecs::pwl_eval(double t) {
+		auto &points = *pwl.points;
+
+		// First point after t, the segment of t starts at the point before it
+		auto next = std::upper_bound(points.begin(), points.end(), t,
+									 [](double t, const std::pair<float, float> &point) { return t < point.first; });
+
 		// Case of t before first point
-		if (t < (*pwl.points)[0].first) {
-			return (*pwl.points)[0].second;
+		if (next == points.begin()) {
+			return points[0].second;
+		}
+
+		// Case of t after the last point
+		if (next == points.end()) {
+			return points.back().second;
 		}
 
 		// Case of t between points
-		for (int i = 0; i < pwl.points->size() - 1; i++) {
-			if (t >= (*pwl.points)[i].first && t < (*pwl.points)[i + 1].first) {
-				return (*pwl.points)[i].second + pwl.slopes[i] * (t - (*pwl.points)[i].first);
+		int i = next - points.begin() - 1;
+		return points[i].second + pwl.slopes[i] * (t - points[i].first);
+	}
+
+	/* Parameters that define the waveform, equal for sources whose waveforms are identical */
+	std::vector<double> TransientSpecs::parameters()
+	{
+		switch (type)
+		{
+		case EXP:
+			return {EXP, exp.i1, exp.i2, exp.td1, exp.tc1, exp.td2, exp.tc2};
+		case SIN:
+			return {SIN, sin.i1, sin.ia, sin.fr, sin.td, sin.df, sin.ph};
+		case PULSE:
+			return {PULSE, pulse.i1, pulse.i2, pulse.td, pulse.tr, pulse.tf, pulse.pw, pulse.per};
+		case PWL: {
+			std::vector<double> p = {PWL};
+			for (auto &point : *pwl.points) {
+				p.push_back(point.first);
+				p.push_back(point.second);
+			}
+			return p;
+		}
+		}
+		assert(0);
+	}
+
+	/* First time after t where the waveform (or its slope) changes abruptly, infinity if there is none */
+	double TransientSpecs::next_breakpoint(double t)
+	{
+		double next = INFINITY;
+
+		switch (type)
+		{
+		case EXP:
+			for (double c : {exp.td1, exp.td2}) {
+				if (c > t) {
+					next = std::min(next, c);
+				}
+			}
+			break;
+		case SIN:
+			if (sin.td > t) {
+				next = sin.td;
+			}
+			break;
+		case PULSE: {
+			// The corners of the period of t and of the next one, pulse_eval repeats from 0.0 every per
+			double start = std::floor(t / pulse.per) * pulse.per;
+			for (double period : {start, start + pulse.per}) {
+				for (double c : {0.0, pulse.td, pulse.peak, pulse.fall_start, pulse.fall_end}) {
+					if (c < pulse.per && period + c > t) {
+						next = std::min(next, period + c);
+					}
+				}
+			}
+			break;
+		}
+		case PWL:
+			for (auto &point : *pwl.points) {
+				if (point.first > t) {
+					next = point.first;
+					break;
+				}
+			}
+			break;
+		}
+
+		return next;
+	}
+
+	/******************************************************************/
+	/*             Routines for BreakpointScheduler class             */
+	/******************************************************************/
+
+	BreakpointScheduler::BreakpointScheduler(double resolution, const std::vector<TransientSpecs *> &waveforms) :
+		resolution(resolution)
+	{
+		for (auto specs : waveforms) {
+			push(specs, 0.0);
+		}
+	}
+
+	void BreakpointScheduler::push(TransientSpecs *specs, double t)
+	{
+		if (!specs) {
+			return;
+		}
+
+		double c = specs->next_breakpoint(t);
+		if (std::isfinite(c)) {
+			queue.push({std::llround(c / resolution), c, specs});
+		}
+	}
+
+	long BreakpointScheduler::next(long tick)
+	{
+		// Replace the passed corners with the next corners of their waveforms
+		while (!queue.empty() && std::get<0>(queue.top()) <= tick) {
+			auto [_, c, specs] = queue.top();
+			queue.pop();
+			push(specs, c);
+		}
+
+		return (queue.empty()) ? LONG_MAX : std::get<0>(queue.top());
+	}
+
+	/******************************************************************/
+	/*               Routines for SourceEvaluator class               */
+	/******************************************************************/
+
+	// Hash of the waveform parameters, for finding the sources with identical waveforms
+	struct parameters_hash {
+		size_t operator()(const std::vector<double> &p) const
+		{
+			size_t h = p.size();
+			for (double v : p) {
+				h ^= std::hash<double>{}(v) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			}
+			return h;
+		}
+	};
+
+	SourceEvaluator::SourceEvaluator(int n, int total_nodes, Scenario *scenario) : sources(0), dc_vector(Eigen::VectorXd::Zero(n))
+	{
+		// Distinct waveforms of each type and the stamps that refer to them, as (row, sign, type, index in type)
+		std::vector<TransientSpecs *> groups[4];
+		std::unordered_map<std::vector<double>, int, parameters_hash> unique;
+		std::vector<std::tuple<int, double, int, int>> stamps;
+
+		auto add_source = [&](Source &source, std::initializer_list<std::pair<int, double>> source_stamps) {
+			TransientSpecs *specs = source.transient_specs;
+			if (!specs) {
+				for (auto [row, sign] : source_stamps) {
+					dc_vector[row] += sign * source.value;
+				}
+				return;
+			}
+
+			auto &group = groups[specs->type];
+			auto [it, inserted] = unique.try_emplace(specs->parameters(), group.size());
+			if (inserted) {
+				group.push_back(specs);
 			}
+			for (auto [row, sign] : source_stamps) {
+				stamps.push_back({row, sign, specs->type, it->second});
+			}
+			sources++;
+		};
+
+		for (int i = 0; i < netlist.current_sources.size(); i++) {
+			Source &source = (scenario) ? scenario->current_source(i) : netlist.current_sources.elements[i];
+			int node_positive = source.node_positive;
+			int node_negative = source.node_negative;
+
+			if (node_positive > 0 && node_negative > 0) {
+				add_source(source, {{node_positive - 1, -1.0}, {node_negative - 1, 1.0}});
+			} else if (node_positive > 0) {
+				add_source(source, {{node_positive - 1, -1.0}});
+			} else if (node_negative > 0) {
+				add_source(source, {{node_negative - 1, 1.0}});
+			}
+		}
+		for (int i = 0; i < netlist.voltage_sources.size(); i++) {
+			add_source((scenario) ? scenario->voltage_source(i) : netlist.voltage_sources.elements[i], {{total_nodes - 1 + i, 1.0}});
+		}
+
+		auto gather = [](std::vector<TransientSpecs *> &group, auto field) {
+			Eigen::ArrayXd a(group.size());
+			for (int i = 0; i < group.size(); i++) {
+				a[i] = field(*group[i]);
+			}
+			return a;
+		};
+
+		auto &e = groups[TransientSpecs::EXP];
+		exp.i1 = gather(e, [](TransientSpecs &s) { return s.exp.i1; });
+		exp.idiff = gather(e, [](TransientSpecs &s) { return s.exp.idiff; });
+		exp.td1 = gather(e, [](TransientSpecs &s) { return s.exp.td1; });
+		exp.tc1 = gather(e, [](TransientSpecs &s) { return s.exp.tc1; });
+		exp.td2 = gather(e, [](TransientSpecs &s) { return s.exp.td2; });
+		exp.tc2 = gather(e, [](TransientSpecs &s) { return s.exp.tc2; });
+
+		auto &sn = groups[TransientSpecs::SIN];
+		sin.i1 = gather(sn, [](TransientSpecs &s) { return s.sin.i1; });
+		sin.ia = gather(sn, [](TransientSpecs &s) { return s.sin.ia; });
+		sin.td = gather(sn, [](TransientSpecs &s) { return s.sin.td; });
+		sin.df = gather(sn, [](TransientSpecs &s) { return s.sin.df; });
+		sin.initial_phase = gather(sn, [](TransientSpecs &s) { return s.sin.initial_phase; });
+		sin.omega = gather(sn, [](TransientSpecs &s) { return s.sin.omega; });
+
+		auto &p = groups[TransientSpecs::PULSE];
+		pulse.i1 = gather(p, [](TransientSpecs &s) { return s.pulse.i1; });
+		pulse.i2 = gather(p, [](TransientSpecs &s) { return s.pulse.i2; });
+		pulse.td = gather(p, [](TransientSpecs &s) { return s.pulse.td; });
+		pulse.tr = gather(p, [](TransientSpecs &s) { return s.pulse.tr; });
+		pulse.tf = gather(p, [](TransientSpecs &s) { return s.pulse.tf; });
+		pulse.per = gather(p, [](TransientSpecs &s) { return s.pulse.per; });
+		pulse.diff = gather(p, [](TransientSpecs &s) { return s.pulse.diff; });
+		pulse.peak = gather(p, [](TransientSpecs &s) { return s.pulse.peak; });
+		pulse.fall_start = gather(p, [](TransientSpecs &s) { return s.pulse.fall_start; });
+		pulse.fall_end = gather(p, [](TransientSpecs &s) { return s.pulse.fall_end; });
+
+		pwl.specs = groups[TransientSpecs::PWL];
+		pwl.cursors.assign(pwl.specs.size(), 0);
+
+		// Index of the first waveform of each type in values
+		int offsets[4] = {0};
+		for (int type = 1; type < 4; type++) {
+			offsets[type] = offsets[type - 1] + groups[type - 1].size();
+		}
+		waveforms = offsets[3] + pwl.specs.size();
+		values.resize(waveforms);
+		for (auto &group : groups) {
+			distinct.insert(distinct.end(), group.begin(), group.end());
+		}
+
+		// Stamps of the same waveform on the same row are summed
+		std::vector<Eigen::Triplet<double>> triplets;
+		for (auto [row, sign, type, index] : stamps) {
+			triplets.emplace_back(row, offsets[type] + index, sign);
+		}
+		incidence.resize(n, waveforms);
+		incidence.setFromTriplets(triplets.begin(), triplets.end());
+	}
+
+	/* Same values as TransientSpecs::eval, evaluated for all the waveforms of a type at once */
+	void SourceEvaluator::eval(double t, Eigen::VectorXd &source_vector)
+	{
+		int offset = 0;
+
+		// EXP, the fall term is replaced by 1 before td2 so that both segments share the formula
+		Eigen::ArrayXd rise = (-(t - exp.td1) / exp.tc1).exp();
+		Eigen::ArrayXd fall = (exp.td2 < t).select((-(t - exp.td2) / exp.tc2).exp(), 1.0);
+		values.segment(offset, exp.i1.size()) = (exp.td1 < t).select(exp.i1 + exp.idiff * (fall - rise), exp.i1);
+		offset += exp.i1.size();
+
+		// SIN, before td the time since td is clamped to 0
+		Eigen::ArrayXd dt = (t - sin.td).max(0.0);
+		values.segment(offset, sin.i1.size()) =
+			sin.i1 + sin.ia * (sin.omega * dt + sin.initial_phase).sin() * (-dt * sin.df).exp();
+		offset += sin.i1.size();
+
+		// PULSE, in terms of a single period
+		Eigen::ArrayXd t_rem = t - pulse.per * (t / pulse.per).floor();
+		values.segment(offset, pulse.i1.size()) =
+			(t_rem <= pulse.td).select(pulse.i1,
+			(t_rem <= pulse.peak).select(pulse.i1 + pulse.diff * (t_rem - pulse.td) / pulse.tr,
+			(t_rem <= pulse.fall_start).select(pulse.i2,
+			(t_rem <= pulse.fall_end).select(pulse.i2 - pulse.diff * (t_rem - pulse.fall_start) / pulse.tf,
+			pulse.i1))));
+		offset += pulse.i1.size();
+
+		// PWL
+		for (int i = 0; i < pwl.specs.size(); i++) {
+			values[offset + i] = pwl_eval(pwl.specs[i], pwl.cursors[i], t);
 		}
 
-		// Case of t after the last point (no need to check)
-		return (*pwl.points)[pwl.points->size() - 1].second;
+		// Scatter the time-varying stamps on top of the constant ones
+		source_vector = dc_vector;
+		source_vector.noalias() += incidence * values.matrix();
+	}
+
+	/* Moves the cursor to the segment of t, which is usually the same or the next one */
+	double SourceEvaluator::pwl_eval(TransientSpecs *specs, int &cursor, double t)
+	{
+		auto &points = *specs->pwl.points;
+
+		if (t < points[0].first) {
+			return points[0].second;
+		}
+
+		while (cursor > 0 && t < points[cursor].first) {
+			cursor--;
+		}
+		while (cursor + 1 < points.size() && t >= points[cursor + 1].first) {
+			cursor++;
+		}
+
+		if (cursor + 1 == points.size()) {
+			return points.back().second;
+		}
+		return points[cursor].second + specs->pwl.slopes[cursor] * (t - points[cursor].first);
 	}
 
 	/******************************************************************/
@@ -100,6 +393,11 @@ namespace spic {
 		tran_mna_sparse_system = system;
 	}
 
+	void TransientAnalysis::load_cache(FactorizationCache *factorizations)
+	{
+		cache = factorizations;
+	}
+
 	/* Main routine for executing a Transient Analysis */
 	void TransientAnalysis::run(Solver &solver,
 								std::vector<std::string> &prints,
@@ -126,8 +424,20 @@ namespace spic {
 		unique_elements.insert(plots.begin(), plots.end());
 		std::vector<std::string> unique_vector(unique_elements.begin(), unique_elements.end());
 
+		// The scenarios are advanced together, each with its own outputs
+		if (!commands.scenarios.empty()) {
+			run_scenarios(solver, unique_vector, transient_dir, plots, logger);
+			delete curr_source_vector_ptr;
+			return;
+		}
+
 		std::unordered_map<std::string, std::vector<double>> transient_data;
 		std::vector<double> transient_times;
+		std::vector<int> transient_iterations;
+		std::vector<double> iteration_times;
+
+		// Previous solutions used by the predictor of iterative solves, newest first
+		std::deque<Eigen::VectorXd> history;
 
 		// Init vector of vectors
 		for (auto &print_node : unique_vector) {
@@ -139,45 +449,96 @@ namespace spic {
 		// Find the transient source vector for the initial time which is 0.0
 		int total_nodes = (ops.sparse) ? tran_mna_sparse_system->mna_sparse_system.total_nodes :
 								 	 	 tran_mna_system->mna_system.total_nodes;
-		calculate_source_vector(*curr_source_vector_ptr, total_nodes, 0.0);
+		SourceEvaluator sources(n, total_nodes);
+		logger.log(INFO, "The " + std::to_string(sources.sources) + " transient sources have "
+							+ std::to_string(sources.waveforms) + " distinct waveforms.");
+		sources.eval(0.0, *curr_source_vector_ptr);
 
-		// Solve the MNA system for the initial time
-		solver.analyze();
+		// Solve the MNA system for the initial time, on the DC matrix since a previous
+		// analysis may have replaced A with its transient matrix (or factored/scaled it in place).
+		// The cache never replaces A, and keeps the DC factorization of the previous analyses.
+		// Otherwise the dense direct methods factor A in place, so it is restored to G at the end
+		// also by the paths that solve the steps on their own copies (adaptive, Parareal, EXP).
+		if (cache) {
+			cache->get(0.0);
+		} else {
+			if (ops.sparse) {
+				tran_mna_sparse_system->mna_sparse_system.A = tran_mna_sparse_system->G;
+				tran_mna_sparse_system->dc_overwritten = true;
+			} else {
+				tran_mna_system->mna_system.A = tran_mna_system->G;
+				tran_mna_system->dc_overwritten = true;
+			}
+			solver.analyze();
+		}
 		solver.solve(*curr_source_vector_ptr);
-
-		Eigen::VectorXd *prev_source_vector_ptr = nullptr;
-		if (ops.transient_method == TR) {
-			prev_source_vector_ptr = new Eigen::VectorXd(*curr_source_vector_ptr);
+		if (ops.iter && ops.predictor > 0) {
+			history.push_front((ops.sparse) ? tran_mna_sparse_system->mna_sparse_system.x : tran_mna_system->mna_system.x);
 		}
 
-		// Create the new transient A matrix and analyze it
-		if (ops.sparse) {
-			tran_mna_sparse_system->create_tran_system(time_step);
+		Eigen::VectorXd *prev_source_vector_ptr = nullptr;
+		Eigen::VectorXd prev_solution;
+		if (ops.transient_method == EXP) {
+			run_exponential(solver, sources, unique_vector, transient_data, transient_times,
+							transient_iterations, iteration_times, logger);
+		} else if (ops.lte_tol > 0) {
+			run_adaptive(solver, sources, unique_vector, transient_data, transient_times,
+						 transient_iterations, iteration_times, logger);
+		} else if (ops.parareal > 1 && steps > 1) {
+			run_parareal(solver, sources, unique_vector, transient_data, transient_times,
+						 transient_iterations, iteration_times, logger);
 		} else {
-			tran_mna_system->create_tran_system(time_step);
-		}
-		solver.analyze();
+			if (ops.transient_method == TR) {
+				prev_source_vector_ptr = new Eigen::VectorXd(*curr_source_vector_ptr);
+			} else if (ops.transient_method == GEAR) {
+				// The operating point is a steady state, so the solution before it is taken equal to it
+				prev_solution = (ops.sparse) ? tran_mna_sparse_system->mna_sparse_system.x : tran_mna_system->mna_system.x;
+			}
 
-		// Run the transient analysis
-		for (int k = 1; k <= steps; k++) {
-			transient_times.push_back(k * time_step);
+			// Create the new transient A matrix and analyze it, or take its factorization from the cache
+			Solver *step_solver = &solver;
+			if (cache) {
+				step_solver = &cache->get((ops.sparse) ? tran_mna_sparse_system->tran_alpha(time_step) :
+														 tran_mna_system->tran_alpha(time_step));
+			} else {
+				if (ops.sparse) {
+					tran_mna_sparse_system->create_tran_system(time_step);
+				} else {
+					tran_mna_system->create_tran_system(time_step);
+				}
+				solver.analyze();
+			}
 
-			// Calculate the source vector for the current time
-			calculate_source_vector(*curr_source_vector_ptr, total_nodes, transient_times[k-1]);
+			// Run the transient analysis
+			for (int k = 1; k <= steps; k++) {
+				transient_times.push_back(k * time_step);
 
-			Eigen::VectorXd &solution = solve_curr_step(solver,
-														&curr_source_vector_ptr,
-														&prev_source_vector_ptr);
+				// Calculate the source vector for the current time
+				sources.eval(transient_times[k-1], *curr_source_vector_ptr);
 
-			// Store the results for the print nodes
-			for (auto &print_node : unique_vector) {
-				int node_id = node_table.find_node(&print_node) - 1;
-				transient_data[print_node].push_back(solution(node_id));
+				Eigen::VectorXd &solution = solve_curr_step(*step_solver,
+															&curr_source_vector_ptr,
+															&prev_source_vector_ptr,
+															history,
+															prev_solution);
+				if (ops.iter) {
+					transient_iterations.push_back(step_solver->iterations);
+					iteration_times.push_back(transient_times[k-1]);
+				}
+
+				// Store the results for the print nodes
+				for (auto &print_node : unique_vector) {
+					int node_id = node_table.find_node(&print_node) - 1;
+					transient_data[print_node].push_back(solution(node_id));
+				}
 			}
 		}
 
 		// Dump the Transient Analysis results to files
 		dump_results(transient_data, transient_times, unique_vector, transient_dir);
+		if (ops.iter) {
+			dump_iterations(transient_iterations, iteration_times, transient_dir);
+		}
 
 		// Use gnuplot to plot the Transient Analysis results for the plot nodes
 		plot_results(plots, logger, transient_dir);
@@ -186,67 +547,842 @@ namespace spic {
 		delete curr_source_vector_ptr;
 	}
 
+	/* Weights of the values at ts[0..m) in the Lagrange polynomial through them, evaluated at t */
+	static std::vector<double> lagrange_weights(const std::vector<double> &ts, int m, double t)
+	{
+		std::vector<double> w(m, 1.0);
+		for (int j = 0; j < m; j++) {
+			for (int i = 0; i < m; i++) {
+				if (i != j) {
+					w[j] *= (t - ts[i]) / (ts[j] - ts[i]);
+				}
+			}
+		}
+		return w;
+	}
+
+	/* Adaptive transient analysis with local truncation error control
+	 *  - The steps are time_step * 2^level, so that only a few distinct matrices A = G + alpha * C are
+	 *    factored. The solvers of the most recently used levels are kept and reused.
+	 *  - A step is rejected and the level lowered if its estimated truncation error exceeds LTETOL,
+	 *    the level is raised by up to TRAN_MAX_STEP_GROWTH when the estimate allows larger steps.
+	 *  - Time is counted in ticks of the smallest step, and a step that would pass over the next
+	 *    breakpoint of the sources is shortened to the largest power of 2 ticks that does not.
+	 *    Thus the breakpoints (rounded to ticks) and the output points are landed on exactly.
+	 *  - The outputs are interpolated at the multiples of time_step from the accepted solutions
+	 *    with a polynomial of the order of the method.
+	 */
+	void TransientAnalysis::run_adaptive(Solver &solver,
+										SourceEvaluator &sources,
+										std::vector<std::string> &unique_vector,
+										std::unordered_map<std::string, std::vector<double>> &transient_data,
+										std::vector<double> &transient_times,
+										std::vector<int> &transient_iterations,
+										std::vector<double> &iteration_times,
+										Logger &logger)
+	{
+		options_t &ops = commands.options;
+		int steps = fin_time / time_step;
+		int n = (ops.sparse) ? tran_mna_sparse_system->mna_sparse_system.n : tran_mna_system->mna_system.n;
+		int order = (ops.transient_method == BE) ? 1 : 2;
+
+		std::vector<int> node_ids;
+		for (auto &print_node : unique_vector) {
+			node_ids.push_back(node_table.find_node(&print_node) - 1);
+		}
+
+		// Accepted time points and solutions, newest first, starting from the DC solution at 0.0
+		std::deque<double> times = {0.0};
+		std::deque<Eigen::VectorXd> solutions = {(ops.sparse) ? tran_mna_sparse_system->mna_sparse_system.x :
+																tran_mna_system->mna_system.x};
+
+		Eigen::VectorXd curr_source_vector(n), next_source_vector(n), b(n);
+		sources.eval(0.0, curr_source_vector);
+
+		std::list<step_solver_t> step_solvers;
+		int level = TRAN_MIN_STEP_LEVEL, accepted = 0, rejected = 0, factorizations = 0, corners = 0;
+		bool was_rejected = false;
+
+		double resolution = std::ldexp(time_step, TRAN_MIN_STEP_LEVEL);
+		long tick = 0, fin_tick = (long)steps << -TRAN_MIN_STEP_LEVEL;
+		BreakpointScheduler breakpoints(resolution, sources.distinct);
+		long next_breakpoint = std::min(breakpoints.next(tick), fin_tick);
+
+		for (int k = 1; k <= steps;) {
+			int step_level = level;
+			while (step_level > TRAN_MIN_STEP_LEVEL && tick + (1L << (step_level - TRAN_MIN_STEP_LEVEL)) > next_breakpoint) {
+				step_level--;
+			}
+			long step_ticks = 1L << (step_level - TRAN_MIN_STEP_LEVEL);
+			double h = step_ticks * resolution;
+			double t = (tick + step_ticks) * resolution;
+
+			Solver &step_solver = get_step_solver(step_solvers, step_level, solver, factorizations);
+			Eigen::VectorXd &x = (ops.sparse) ? step_solver.sparse_system->x : step_solver.system->x;
+
+			// Same right-hand sides as update_tran_system_be/tr/gear with the step h
+			sources.eval(t, next_source_vector);
+			if (ops.transient_method == GEAR) {
+				// The constant step formula with the solution one step h back, interpolated from the
+				// accepted solutions, keeps the matrix of every step size at G + 3/(2h) * C
+				std::vector<double> w = lagrange_weights(std::vector<double>(times.begin(), times.end()),
+														 solutions.size(), times[0] - h);
+				b = 4 * solutions[0];
+				for (int j = 0; j < solutions.size(); j++) {
+					b -= w[j] * solutions[j];
+				}
+			} else {
+				b = solutions[0];
+			}
+			b = (ops.sparse) ? Eigen::VectorXd(tran_mna_sparse_system->C * b) : Eigen::VectorXd(tran_mna_system->C * b);
+			if (ops.transient_method == BE) {
+				b = next_source_vector + b / h;
+			} else if (ops.transient_method == GEAR) {
+				b = next_source_vector + b / (2 * h);
+			} else {
+				b = next_source_vector + curr_source_vector + b * (2.0 / h);
+				b -= (ops.sparse) ? Eigen::VectorXd(tran_mna_sparse_system->G * solutions[0]) :
+									Eigen::VectorXd(tran_mna_system->G * solutions[0]);
+			}
+
+			// The solver of the level still holds the solution of its last step,
+			// so start from the newest solution (or its extrapolation) instead
+			x = solutions[0];
+			if (ops.iter && ops.predictor > 0) {
+				int m = std::min<int>(ops.predictor + 1, solutions.size());
+				std::vector<double> w = lagrange_weights(std::vector<double>(times.begin(), times.end()), m, t);
+				x = w[0] * solutions[0];
+				for (int j = 1; j < m; j++) {
+					x += w[j] * solutions[j];
+				}
+			}
+			step_solver.solve(b);
+
+			// The estimate needs order + 1 previous solutions, the first steps are taken at the smallest step
+			double err = (solutions.size() > order) ? lte_norm(times, solutions, x, t, order) : 0.0;
+			if (!(err <= 1.0) && step_level > TRAN_MIN_STEP_LEVEL) {
+				double ratio = TRAN_LTE_SAFETY * std::pow(err, -1.0 / (order + 1));
+				int reduction = std::isfinite(ratio) ? std::max(1, (int)std::ceil(-std::log2(ratio))) : step_level - TRAN_MIN_STEP_LEVEL;
+				level = std::max(TRAN_MIN_STEP_LEVEL, step_level - reduction);
+				was_rejected = true;
+				rejected++;
+				continue;
+			}
+
+			accepted++;
+			times.push_front(t);
+			solutions.push_front(x);
+			if (solutions.size() > order + 1) {
+				times.pop_back();
+				solutions.pop_back();
+			}
+			std::swap(curr_source_vector, next_source_vector);
+
+			tick += step_ticks;
+			if (tick == next_breakpoint) {
+				next_breakpoint = std::min(breakpoints.next(tick), fin_tick);
+				corners++;
+			}
+
+			if (ops.iter) {
+				transient_iterations.push_back(step_solver.iterations);
+				iteration_times.push_back(t);
+			}
+
+			// Interpolate the outputs that the step has passed
+			std::vector<double> ts(times.begin(), times.end());
+			for (; k <= steps && ((long)k << -TRAN_MIN_STEP_LEVEL) <= tick; k++) {
+				double t_out = k * time_step;
+				std::vector<double> w = lagrange_weights(ts, solutions.size(), t_out);
+
+				transient_times.push_back(t_out);
+				for (int i = 0; i < node_ids.size(); i++) {
+					double v = 0;
+					for (int j = 0; j < solutions.size(); j++) {
+						v += w[j] * solutions[j](node_ids[i]);
+					}
+					transient_data[unique_vector[i]].push_back(v);
+				}
+			}
+
+			// Raise the level as far as the estimate allows, but not right after a rejection
+			// or after a step that was shortened by a breakpoint
+			if (!was_rejected && step_level == level && solutions.size() > order && std::isfinite(err)) {
+				double ratio = TRAN_LTE_SAFETY * std::pow(std::max(err, EPS), -1.0 / (order + 1));
+				int growth = std::clamp((int)std::floor(std::log2(ratio)), 0, TRAN_MAX_STEP_GROWTH);
+				level = std::min(TRAN_MAX_STEP_LEVEL, level + growth);
+			}
+			was_rejected = false;
+		}
+
+		for (auto &s : step_solvers) {
+			solver.add_perf_counters(*s.solver);
+		}
+
+		logger.log(INFO, "Adaptive transient analysis took " + std::to_string(accepted) + " steps ("
+							+ std::to_string(rejected) + " rejected, " + std::to_string(corners)
+							+ " on breakpoints) and " + std::to_string(factorizations)
+							+ " factorizations for " + std::to_string(steps) + " output points.");
+	}
+
+	/* Exponential transient analysis of C x' = -G x + e(t)
+	 *  - The sources are linear between two time points, e(t + tau) = e(t) + tau * s, so the solution is
+	 *    the particular solution xp(tau) = G^-1 (e(t) + tau * s - C G^-1 s) plus e^(tau J) (x(t) - xp(0))
+	 *    with J = -C^-1 G, which is exact for piecewise linear sources.
+	 *  - The G solves reuse the factorization of the operating point, and e^(hJ)v is approximated in a
+	 *    rational Krylov subspace with the single factorization of G + C / time_step. Thus steps of any
+	 *    length cost the same, and the steps stop at the breakpoints of the sources besides the outputs.
+	 */
+	void TransientAnalysis::run_exponential(Solver &solver,
+											SourceEvaluator &sources,
+											std::vector<std::string> &unique_vector,
+											std::unordered_map<std::string, std::vector<double>> &transient_data,
+											std::vector<double> &transient_times,
+											std::vector<int> &transient_iterations,
+											std::vector<double> &iteration_times,
+											Logger &logger)
+	{
+		options_t &ops = commands.options;
+		int steps = fin_time / time_step;
+		int n = (ops.sparse) ? tran_mna_sparse_system->mna_sparse_system.n : tran_mna_system->mna_system.n;
+
+		// The solver still holds the factorization of G and the operating point
+		Eigen::VectorXd &g_x = (ops.sparse) ? solver.sparse_system->x : solver.system->x;
+		Eigen::VectorXd x = g_x;
+
+		std::list<step_solver_t> step_solvers;
+		int factorizations = 0;
+		Solver &shift_solver = get_step_solver(step_solvers, 0, solver, factorizations);
+
+		Eigen::VectorXd curr_source_vector(n), next_source_vector(n), slope_solution(n);
+		sources.eval(0.0, curr_source_vector);
+
+		// Time is counted in ticks of the smallest adaptive step, as the breakpoints are
+		double resolution = std::ldexp(time_step, TRAN_MIN_STEP_LEVEL);
+		long tick = 0;
+		BreakpointScheduler breakpoints(resolution, sources.distinct);
+		long next_breakpoint = breakpoints.next(tick);
+		int taken = 0, corners = 0, dimensions = 0;
+
+		for (int k = 1; k <= steps; k++) {
+			long out_tick = (long)k << -TRAN_MIN_STEP_LEVEL;
+			int iterations = 0;
+
+			while (tick < out_tick) {
+				long next_tick = std::min(out_tick, next_breakpoint);
+				double h = (next_tick - tick) * resolution;
+				sources.eval(next_tick * resolution, next_source_vector);
+
+				// G^-1 s and xp(h), then x(t) - xp(0) = x(t) - xp(h) + h G^-1 s
+				solver.solve((next_source_vector - curr_source_vector) / h);
+				slope_solution = g_x;
+				iterations += solver.iterations;
+				solver.solve(next_source_vector - ((ops.sparse) ? Eigen::VectorXd(tran_mna_sparse_system->C * slope_solution) :
+																  Eigen::VectorXd(tran_mna_system->C * slope_solution)));
+				iterations += solver.iterations;
+				x += h * slope_solution - g_x;
+
+				int krylov_iterations;
+				dimensions += exp_krylov(shift_solver, time_step, h, x, krylov_iterations);
+				iterations += krylov_iterations;
+				x += g_x;
+
+				taken++;
+				tick = next_tick;
+				if (tick == next_breakpoint) {
+					next_breakpoint = breakpoints.next(tick);
+					corners++;
+				}
+				std::swap(curr_source_vector, next_source_vector);
+			}
+
+			transient_times.push_back(k * time_step);
+			if (ops.iter) {
+				transient_iterations.push_back(iterations);
+				iteration_times.push_back(k * time_step);
+			}
+			for (auto &print_node : unique_vector) {
+				int node_id = node_table.find_node(&print_node) - 1;
+				transient_data[print_node].push_back(x(node_id));
+			}
+		}
+
+		for (auto &s : step_solvers) {
+			solver.add_perf_counters(*s.solver);
+		}
+
+		logger.log(INFO, "Exponential transient analysis took " + std::to_string(taken) + " steps ("
+							+ std::to_string(corners) + " on breakpoints) with an average Krylov dimension of "
+							+ std::to_string((taken) ? (double)dimensions / taken : 0.0) + ".");
+	}
+
+	/* Replaces v with e^(hJ) v, where J = -C^-1 G, and returns the dimension of the Krylov subspace
+	 *  - The subspace is the rational Krylov subspace of (C + gamma G)^-1 C = A^-1 C / gamma, where
+	 *    A = G + C / gamma is factored by shift_solver. It exists even if C is singular (nodes without
+	 *    capacitors, voltage source rows), and its eigenvalues 1 / (1 - gamma * lambda(J)) are in (0, 1],
+	 *    so the stiff modes of J are approximated well by a small subspace.
+	 *  - The Arnoldi relation (C + gamma G)^-1 C V = V H gives J ~ V (I - H^-1) V^T / gamma, so
+	 *    e^(hJ) v ~ |v| V e^(h / gamma (I - H^-1)) e1, and the small exponential is computed densely.
+	 *  - The dimension grows until h_(m+1,m) |e_m^T H^-1 e^(h / gamma (I - H^-1)) e1| < EXP_KRYLOV_TOL.
+	 */
+	int TransientAnalysis::exp_krylov(Solver &shift_solver, double gamma, double h, Eigen::VectorXd &v, int &iterations)
+	{
+		options_t &ops = commands.options;
+		Eigen::VectorXd &x = (ops.sparse) ? shift_solver.sparse_system->x : shift_solver.system->x;
+
+		iterations = 0;
+		double beta = v.norm();
+		if (beta == 0) {
+			return 0;
+		}
+
+		Eigen::MatrixXd V(v.size(), EXP_MAX_KRYLOV_DIM + 1);
+		Eigen::MatrixXd H = Eigen::MatrixXd::Zero(EXP_MAX_KRYLOV_DIM + 1, EXP_MAX_KRYLOV_DIM);
+		Eigen::VectorXd u;
+		V.col(0) = v / beta;
+
+		int m = 0;
+		while (m < EXP_MAX_KRYLOV_DIM) {
+			shift_solver.solve((ops.sparse) ? Eigen::VectorXd(tran_mna_sparse_system->C * V.col(m) / gamma) :
+											  Eigen::VectorXd(tran_mna_system->C * V.col(m) / gamma));
+			iterations += shift_solver.iterations;
+
+			// Modified Gram-Schmidt
+			Eigen::VectorXd w = x;
+			for (int i = 0; i <= m; i++) {
+				H(i, m) = V.col(i).dot(w);
+				w -= H(i, m) * V.col(i);
+			}
+			H(m + 1, m) = w.norm();
+			m++;
+
+			Eigen::MatrixXd H_inv = H.topLeftCorner(m, m).partialPivLu().inverse();
+			u = ((h / gamma) * (Eigen::MatrixXd::Identity(m, m) - H_inv)).exp().col(0);
+
+			// A zero h_(m+1,m) means that the subspace is invariant and the approximation exact
+			if (H(m, m - 1) * std::abs(H_inv.row(m - 1).dot(u)) <= EXP_KRYLOV_TOL) {
+				break;
+			}
+			V.col(m) = w / H(m, m - 1);
+		}
+
+		v = beta * (V.leftCols(m) * u);
+		return m;
+	}
+
+	/* Parareal transient analysis over ops.parareal time slices of about equal output points
+	 *  - The coarse propagator takes a single Backward-Euler step over a slice and runs sequentially,
+	 *    the fine propagator takes the steps of the user's method and runs the slices concurrently,
+	 *    every thread on its own source evaluator. The threads of a direct method share one factorization
+	 *    of the fine matrix, the ones of an iterative method run their own solver and system.
+	 *  - Every iteration corrects the slice boundaries with U(j+1) = C(U(j)) + F(U_old(j)) - C(U_old(j)),
+	 *    until none changes by more than PARAREAL_TOL. After i iterations the first i slices are
+	 *    exact, so they are not propagated again, and at most ops.parareal iterations are needed.
+	 *  - The outputs of every slice are those of its last fine propagation.
+	 */
+	void TransientAnalysis::run_parareal(Solver &solver,
+										SourceEvaluator &sources,
+										std::vector<std::string> &unique_vector,
+										std::unordered_map<std::string, std::vector<double>> &transient_data,
+										std::vector<double> &transient_times,
+										std::vector<int> &transient_iterations,
+										std::vector<double> &iteration_times,
+										Logger &logger)
+	{
+		options_t &ops = commands.options;
+		int steps = fin_time / time_step;
+		int slices = std::min(ops.parareal, steps);
+		int workers = std::min(slices, omp_get_max_threads());
+		int n = (ops.sparse) ? tran_mna_sparse_system->mna_sparse_system.n : tran_mna_system->mna_system.n;
+
+		std::vector<int> node_ids;
+		for (auto &print_node : unique_vector) {
+			node_ids.push_back(node_table.find_node(&print_node) - 1);
+		}
+
+		// Slice j covers the output points (bounds[j], bounds[j+1]]
+		std::vector<int> bounds(slices + 1);
+		for (int j = 0; j <= slices; j++) {
+			bounds[j] = (long)j * steps / slices;
+		}
+
+		// The slices differ by at most one output point, so there are at most two coarse steps
+		std::list<step_solver_t> coarse_solvers;
+		auto coarse = [&](Eigen::VectorXd &x, int j) {
+			int length = bounds[j + 1] - bounds[j];
+			auto it = std::find_if(coarse_solvers.begin(), coarse_solvers.end(),
+								   [length](step_solver_t &s) { return s.level == length; });
+			if (it == coarse_solvers.end()) {
+				coarse_solvers.emplace_front();
+				it = coarse_solvers.begin();
+				it->level = length;
+				build_step_solver(*it, 1 / (length * time_step), solver);
+				it->solver->analyze();
+			}
+
+			Eigen::VectorXd b(n);
+			sources.eval(bounds[j + 1] * time_step, b);
+			b += ((ops.sparse) ? Eigen::VectorXd(tran_mna_sparse_system->C * x) :
+								 Eigen::VectorXd(tran_mna_system->C * x)) / (length * time_step);
+
+			Eigen::VectorXd &x_coarse = (ops.sparse) ? it->solver->sparse_system->x : it->solver->system->x;
+			x_coarse = x;
+			it->solver->solve(b);
+			return Eigen::VectorXd(x_coarse);
+		};
+
+		// The workers of a direct method solve against one factorization of the fine matrix. The iterative
+		// methods keep state in their solver, so every worker analyzes its own copy of the fine matrix.
+		// Every worker runs its solves on an equal share of the threads in a nested region.
+		int threads = std::max(1, omp_get_max_threads() / workers);
+		int levels = omp_get_max_active_levels();
+		omp_set_max_active_levels(2);
+		double alpha = (ops.transient_method == TR) ? 2 / time_step : 1 / time_step;
+		std::vector<step_solver_t> fine_solvers(1);
+		build_step_solver(fine_solvers[0], alpha, solver);
+		bool shared = fine_solvers[0].solver->concurrent_solves();
+		if (shared) {
+			fine_solvers[0].solver->analyze();
+		} else {
+			fine_solvers.resize(workers);
+			for (int w = 1; w < workers; w++) {
+				build_step_solver(fine_solvers[w], alpha, solver);
+			}
+			#pragma omp parallel num_threads(workers)
+			{
+				omp_set_num_threads(threads);
+				fine_solvers[omp_get_thread_num()].solver->analyze();
+			}
+		}
+		std::vector<SourceEvaluator> fine_sources(workers, sources);
+		int shared_solves = 0;
+
+		// Boundary solutions, their coarse and fine propagations, and the outputs of every slice
+		std::vector<Eigen::VectorXd> U(slices + 1), coarse_U(slices), fine_U(slices);
+		std::vector<Eigen::MatrixXd> outputs(slices);
+		std::vector<std::vector<int>> iterations(slices);
+
+		U[0] = (ops.sparse) ? solver.sparse_system->x : solver.system->x;
+		for (int j = 0; j < slices; j++) {
+			coarse_U[j] = coarse(U[j], j);
+			U[j + 1] = coarse_U[j];
+		}
+
+		int iteration = 0;
+		double change = INFINITY;
+		while (iteration < slices && change > PARAREAL_TOL) {
+			#pragma omp parallel num_threads(workers)
+			{
+				int w = omp_get_thread_num();
+				omp_set_num_threads(threads);
+
+				#pragma omp for schedule(dynamic)
+				for (int j = iteration; j < slices; j++) {
+					fine_U[j] = U[j];
+					parareal_fine(*fine_solvers[(shared) ? 0 : w].solver, shared, fine_sources[w], fine_U[j],
+								  bounds[j], bounds[j + 1], node_ids, outputs[j], iterations[j]);
+				}
+			}
+			if (shared) {
+				shared_solves += bounds[slices] - bounds[iteration];
+			}
+
+			// Slice iteration starts from an exact solution, thus its fine propagation is exact too
+			change = 0;
+			U[iteration + 1] = fine_U[iteration];
+			for (int j = iteration + 1; j < slices; j++) {
+				Eigen::VectorXd g = coarse(U[j], j);
+				Eigen::VectorXd u = g + fine_U[j] - coarse_U[j];
+				change = std::max(change, ((u - U[j + 1]).array().abs() / (1.0 + u.array().abs())).maxCoeff());
+				coarse_U[j] = g;
+				U[j + 1] = u;
+			}
+			iteration++;
+		}
+		omp_set_max_active_levels(levels);
+
+		for (int j = 0; j < slices; j++) {
+			for (int r = 0; r < outputs[j].rows(); r++) {
+				int k = bounds[j] + r + 1;
+				transient_times.push_back(k * time_step);
+				for (int i = 0; i < node_ids.size(); i++) {
+					transient_data[unique_vector[i]].push_back(outputs[j](r, i));
+				}
+				if (ops.iter) {
+					transient_iterations.push_back(iterations[j][r]);
+					iteration_times.push_back(k * time_step);
+				}
+			}
+		}
+
+		for (auto &s : coarse_solvers) {
+			solver.add_perf_counters(*s.solver);
+		}
+		// The concurrent solves against the shared factorization are not counted by the solver
+		fine_solvers[0].solver->perf_counter.block_solve_calls += shared_solves;
+		fine_solvers[0].solver->perf_counter.block_solve_rhs += shared_solves;
+		for (auto &s : fine_solvers) {
+			solver.add_perf_counters(*s.solver);
+		}
+
+		logger.log(INFO, "Parareal transient analysis took " + std::to_string(iteration) + " iterations over "
+							+ std::to_string(slices) + " time slices on " + std::to_string(workers)
+							+ " workers of " + std::to_string(threads) + " threads, with a last boundary change of " + std::to_string(change) + ".");
+	}
+
+	/* Fine propagation of x from the output point k_begin to k_end with the fixed step of the TR or
+	 * BE method. The right-hand sides are those of update_tran_system_tr/be, built on local vectors
+	 * so that the slices can be propagated concurrently. Row r of outputs holds the print nodes
+	 * at the output point k_begin + r + 1.
+	 */
+	void TransientAnalysis::parareal_fine(Solver &fine_solver, bool shared, SourceEvaluator &sources, Eigen::VectorXd &x,
+										  int k_begin, int k_end, const std::vector<int> &node_ids,
+										  Eigen::MatrixXd &outputs, std::vector<int> &iterations)
+	{
+		options_t &ops = commands.options;
+		Eigen::VectorXd &x_fine = (ops.sparse) ? fine_solver.sparse_system->x : fine_solver.system->x;
+		Eigen::VectorXd curr_source_vector(x.size()), next_source_vector(x.size()), b;
+
+		outputs.resize(k_end - k_begin, node_ids.size());
+		iterations.clear();
+
+		sources.eval(k_begin * time_step, curr_source_vector);
+		for (int k = k_begin + 1; k <= k_end; k++) {
+			sources.eval(k * time_step, next_source_vector);
+
+			b = (ops.sparse) ? Eigen::VectorXd(tran_mna_sparse_system->C * x) : Eigen::VectorXd(tran_mna_system->C * x);
+			if (ops.transient_method == BE) {
+				b = next_source_vector + b / time_step;
+			} else {
+				b = next_source_vector + curr_source_vector + b * (2.0 / time_step);
+				b -= (ops.sparse) ? Eigen::VectorXd(tran_mna_sparse_system->G * x) :
+									Eigen::VectorXd(tran_mna_system->G * x);
+			}
+
+			if (shared) {
+				// The solution is kept in X of this worker, the x of the shared solver is not used
+				Eigen::MatrixXd X;
+				fine_solver.concurrent_solve(b, X);
+				x = X.col(0);
+			} else {
+				x_fine = x;
+				fine_solver.solve(b);
+				x = x_fine;
+			}
+			std::swap(curr_source_vector, next_source_vector);
+
+			for (int i = 0; i < node_ids.size(); i++) {
+				outputs(k - k_begin - 1, i) = x(node_ids[i]);
+			}
+			iterations.push_back((shared) ? 0 : fine_solver.iterations);
+		}
+	}
+
+	/* Transient analysis of every scenario with the fixed step of the TR, BE or GEAR method. The
+	 * scenarios share G and C, thus each step is a single block solve against one factorization
+	 * of A = G + alpha * C, with the right-hand sides of update_tran_system_be/tr/gear of the
+	 * scenarios in the columns. The outputs of scenario j are dumped in transient_dir/scenario_<j>.
+	 */
+	void TransientAnalysis::run_scenarios(Solver &solver,
+										  std::vector<std::string> &unique_vector,
+										  std::filesystem::path transient_dir,
+										  std::vector<std::string> &plots,
+										  Logger &logger)
+	{
+		options_t &ops = commands.options;
+		std::vector<Scenario> &scenarios = commands.scenarios;
+		int m = scenarios.size();
+		int steps = fin_time / time_step;
+		int n = (ops.sparse) ? tran_mna_sparse_system->mna_sparse_system.n : tran_mna_system->mna_system.n;
+		int total_nodes = (ops.sparse) ? tran_mna_sparse_system->mna_sparse_system.total_nodes :
+										 tran_mna_system->mna_system.total_nodes;
+
+		std::vector<int> node_ids;
+		for (auto &print_node : unique_vector) {
+			node_ids.push_back(node_table.find_node(&print_node) - 1);
+		}
+
+		std::vector<SourceEvaluator> sources;
+		for (auto &scenario : scenarios) {
+			sources.emplace_back(n, total_nodes, &scenario);
+		}
+
+		// Source vectors of the scenarios at a time point, one per column
+		Eigen::VectorXd e(n);
+		auto eval = [&](double t, Eigen::MatrixXd &E) {
+			for (int j = 0; j < m; j++) {
+				sources[j].eval(t, e);
+				E.col(j) = e;
+			}
+		};
+		auto C_times = [&](const Eigen::MatrixXd &X) {
+			return (ops.sparse) ? Eigen::MatrixXd(tran_mna_sparse_system->C * X) : Eigen::MatrixXd(tran_mna_system->C * X);
+		};
+
+		// Operating points of the scenarios on the DC matrix, as in run()
+		Eigen::MatrixXd E(n, m), E_prev, B, X = Eigen::MatrixXd::Zero(n, m), X_prev;
+		eval(0.0, E);
+		if (cache) {
+			cache->get(0.0);
+		} else {
+			if (ops.sparse) {
+				tran_mna_sparse_system->mna_sparse_system.A = tran_mna_sparse_system->G;
+			} else {
+				tran_mna_system->mna_system.A = tran_mna_system->G;
+			}
+			solver.analyze();
+		}
+		solver.solve(E, X);
+
+		if (ops.transient_method == TR) {
+			E_prev = E;
+		} else if (ops.transient_method == GEAR) {
+			X_prev = X; // The operating point is a steady state
+		}
+
+		Solver *step_solver = &solver;
+		if (cache) {
+			step_solver = &cache->get((ops.sparse) ? tran_mna_sparse_system->tran_alpha(time_step) :
+													 tran_mna_system->tran_alpha(time_step));
+		} else {
+			if (ops.sparse) {
+				tran_mna_sparse_system->create_tran_system(time_step);
+			} else {
+				tran_mna_system->create_tran_system(time_step);
+			}
+			solver.analyze();
+		}
+
+		// Row k - 1 of outputs[j] holds the print nodes of scenario j at the output point k
+		std::vector<Eigen::MatrixXd> outputs(m, Eigen::MatrixXd(steps, node_ids.size()));
+		std::vector<double> transient_times;
+		std::vector<int> transient_iterations;
+
+		for (int k = 1; k <= steps; k++) {
+			transient_times.push_back(k * time_step);
+			eval(transient_times[k-1], E);
+
+			if (ops.transient_method == BE) {
+				B = E + C_times(X) / time_step;
+			} else if (ops.transient_method == GEAR) {
+				B = E + C_times(4 * X - X_prev) / (2 * time_step);
+				X_prev = X;
+			} else {
+				B = E + E_prev + C_times(X) * (2.0 / time_step);
+				B -= (ops.sparse) ? Eigen::MatrixXd(tran_mna_sparse_system->G * X) : Eigen::MatrixXd(tran_mna_system->G * X);
+				std::swap(E, E_prev);
+			}
+
+			// The previous solutions are the initial guesses of the iterative methods
+			step_solver->solve(B, X);
+			if (ops.iter) {
+				transient_iterations.push_back(step_solver->iterations);
+			}
+
+			for (int j = 0; j < m; j++) {
+				for (int i = 0; i < node_ids.size(); i++) {
+					outputs[j](k - 1, i) = X(node_ids[i], j);
+				}
+			}
+		}
+
+		for (int j = 0; j < m; j++) {
+			std::filesystem::path scenario_dir = transient_dir/("scenario_" + std::to_string(j + 1));
+			std::filesystem::create_directories(scenario_dir);
+			logger.log(INFO, "Dumping scenario " + scenarios[j].file.string() + " to " + scenario_dir.string());
+
+			std::unordered_map<std::string, std::vector<double>> transient_data;
+			for (int i = 0; i < node_ids.size(); i++) {
+				Eigen::VectorXd column = outputs[j].col(i);
+				transient_data[unique_vector[i]] = std::vector<double>(column.data(), column.data() + steps);
+			}
+
+			dump_results(transient_data, transient_times, unique_vector, scenario_dir);
+			if (ops.iter) {
+				dump_iterations(transient_iterations, transient_times, scenario_dir);
+			}
+			plot_results(plots, logger, scenario_dir);
+		}
+
+		logger.log(INFO, "The " + std::to_string(m) + " scenarios took " + std::to_string(steps)
+							+ " block solves of " + std::to_string(m) + " right-hand sides.");
+	}
+
+	/* Solver of the step time_step * 2^level, which is moved to the front of the most recently used list.
+	 * A missing one is built on a copy of A = G + alpha * C, and the least recently used solver
+	 * is dropped when TRAN_STEP_SOLVERS are already kept. With a factorization cache the solvers
+	 * are kept there instead, under its memory budget.
+	 */
+	Solver &TransientAnalysis::get_step_solver(std::list<step_solver_t> &step_solvers, int level,
+											   Solver &solver, int &factorizations)
+	{
+		options_t &ops = commands.options;
+		double h = std::ldexp(time_step, level);
+		double alpha = (ops.sparse) ? tran_mna_sparse_system->tran_alpha(h) : tran_mna_system->tran_alpha(h);
+
+		if (cache) {
+			int misses = solver.perf_counter.factorization_misses;
+			Solver &cached = cache->get(alpha);
+			factorizations += solver.perf_counter.factorization_misses - misses;
+			return cached;
+		}
+
+		for (auto it = step_solvers.begin(); it != step_solvers.end(); ++it) {
+			if (it->level == level) {
+				step_solvers.splice(step_solvers.begin(), step_solvers, it);
+				return *step_solvers.front().solver;
+			}
+		}
+
+		if (step_solvers.size() == TRAN_STEP_SOLVERS) {
+			solver.add_perf_counters(*step_solvers.back().solver);
+			step_solvers.pop_back();
+		}
+
+		step_solvers.emplace_front();
+		step_solver_t &s = step_solvers.front();
+		s.level = level;
+		build_step_solver(s, alpha, solver);
+		s.solver->analyze();
+		factorizations++;
+
+		return *s.solver;
+	}
+
+	/* Builds the solver of s on its own copy of A = G + alpha * C, it still has to be analyzed */
+	void TransientAnalysis::build_step_solver(step_solver_t &s, double alpha, Solver &solver)
+	{
+		options_t &ops = commands.options;
+
+		if (ops.sparse) {
+			s.sparse_system = std::make_unique<SparseSystem>(tran_mna_sparse_system->mna_sparse_system.n);
+			s.sparse_system->A = tran_mna_sparse_system->G + alpha * tran_mna_sparse_system->C;
+			s.solver = std::make_unique<Solver>(*s.sparse_system, ops, solver.logger);
+		} else {
+			s.system = std::make_unique<System>(tran_mna_system->mna_system.n);
+			s.system->A = tran_mna_system->G + alpha * tran_mna_system->C;
+			s.solver = std::make_unique<Solver>(*s.system, ops, solver.logger);
+		}
+	}
+
+	/* Weighted max norm of the local truncation error of the step that reached x at t.
+	 * The derivative of order (order + 1) is estimated with the divided difference of x and
+	 * the previous solutions, and the error of every node voltage is weighted by LTETOL * (1 + |x|)
+	 *  - BE: h^2 / 2 * x''  = h^2 * DD2
+	 *  - TR: h^3 / 12 * x''' = h^3 / 2 * DD3
+	 *  - GEAR: 2 h^3 / 9 * x''' = 4 h^3 / 3 * DD3
+	 */
+	double TransientAnalysis::lte_norm(const std::deque<double> &times, const std::deque<Eigen::VectorXd> &solutions,
+									  const Eigen::VectorXd &x, double t, int order)
+	{
+		int nodes = (commands.options.sparse) ? tran_mna_sparse_system->mna_sparse_system.total_nodes - 1 :
+												tran_mna_system->mna_system.total_nodes - 1;
+		std::vector<double> ts = {t};
+		ts.insert(ts.end(), times.begin(), times.begin() + order + 1);
+
+		// Weights of the divided difference over the points ts
+		std::vector<double> w(order + 2, 1.0);
+		for (int j = 0; j < order + 2; j++) {
+			for (int i = 0; i < order + 2; i++) {
+				if (i != j) {
+					w[j] /= ts[j] - ts[i];
+				}
+			}
+		}
+
+		Eigen::VectorXd dd = w[0] * x.head(nodes);
+		for (int j = 1; j < order + 2; j++) {
+			dd += w[j] * solutions[j - 1].head(nodes);
+		}
+
+		double h = t - times[0];
+		double c = (order == 1) ? h * h : (commands.options.transient_method == TR) ? h * h * h / 2 : 4 * h * h * h / 3;
+		return (c * dd.array().abs() / (commands.options.lte_tol * (1.0 + x.head(nodes).array().abs()))).maxCoeff();
+	}
+
 	Eigen::VectorXd &TransientAnalysis::solve_curr_step(Solver &solver,
 														Eigen::VectorXd **curr_source_vector_ptr,
-														Eigen::VectorXd **prev_source_vector_ptr)
+														Eigen::VectorXd **prev_source_vector_ptr,
+														std::deque<Eigen::VectorXd> &history,
+														Eigen::VectorXd &prev_solution)
 	{
+		options_t &ops = commands.options;
+
 		// Update the system's b vector
-		if (commands.options.sparse) { // Sparse
-			if (commands.options.transient_method == BE) {
+		if (ops.sparse) { // Sparse
+			if (ops.transient_method == BE) {
 				tran_mna_sparse_system->update_tran_system_be(**curr_source_vector_ptr, time_step);
+			} else if (ops.transient_method == GEAR) {
+				tran_mna_sparse_system->update_tran_system_gear(**curr_source_vector_ptr, prev_solution, time_step);
+				prev_solution = tran_mna_sparse_system->mna_sparse_system.x;
 			} else {
 				tran_mna_sparse_system->update_tran_system_tr(**curr_source_vector_ptr,
 															  **prev_source_vector_ptr,
 															  time_step);
 				std::swap<Eigen::VectorXd*>(*curr_source_vector_ptr, *prev_source_vector_ptr);
 			}
-
-			// Solve the sparse system
-			solver.solve(tran_mna_sparse_system->mna_sparse_system.b);
-
-			return tran_mna_sparse_system->mna_sparse_system.x;
 		} else { // Dense
-			if (commands.options.transient_method == BE) {
+			if (ops.transient_method == BE) {
 				tran_mna_system->update_tran_system_be(**curr_source_vector_ptr, time_step);
+			} else if (ops.transient_method == GEAR) {
+				tran_mna_system->update_tran_system_gear(**curr_source_vector_ptr, prev_solution, time_step);
+				prev_solution = tran_mna_system->mna_system.x;
 			} else {
 				tran_mna_system->update_tran_system_tr(**curr_source_vector_ptr,
 													   **prev_source_vector_ptr, time_step);
 				std::swap<Eigen::VectorXd*>(*curr_source_vector_ptr, *prev_source_vector_ptr);
 			}
+		}
 
-			// Solve the system
-			solver.solve(tran_mna_system->mna_system.b);
+		Eigen::VectorXd &x = (ops.sparse) ? tran_mna_sparse_system->mna_sparse_system.x : tran_mna_system->mna_system.x;
+		Eigen::VectorXd &b = (ops.sparse) ? tran_mna_sparse_system->mna_sparse_system.b : tran_mna_system->mna_system.b;
 
-			return tran_mna_system->mna_system.x;
+		// The previous solution has been used by the update of b, so x can now hold the initial guess.
+		// The step only has to be solved to a fraction of the change that the predictor expects from
+		// the previous solution, so the tolerance follows it and ITOL is the tightest one
+		if (ops.iter && ops.predictor > 0) {
+			predict_solution(history, x);
+			double change = (x - history[0]).norm() / std::max(history[0].norm(), EPS);
+			solver.set_tolerance(std::max(ops.itol, PREDICTOR_TOL_FACTOR * change));
 		}
-	}
-
-	/* Calculate the source vector for the current time */
-	void TransientAnalysis::calculate_source_vector(Eigen::VectorXd &source_vector, int total_nodes, double time)
-	{
-		// Set Source Vector to zero
-		source_vector.setZero();
 
-		// Add the current sources transient stamp to the source vector
-		for (auto &source : netlist.current_sources.elements) {
-			double value = source.eval(time);
-			int node_positive = source.node_positive;
-			int node_negative = source.node_negative;
+		// Solve the system, a cached solver works on its own system
+		Eigen::VectorXd &x_solver = (ops.sparse) ? solver.sparse_system->x : solver.system->x;
+		if (&x_solver != &x) {
+			x_solver = x;
+			solver.solve(b);
+			x = x_solver;
+		} else {
+			solver.solve(b);
+		}
 
-			if (node_positive > 0) {
-				source_vector[node_positive - 1] -= value;
-			}
-			if (node_negative > 0) {
-				source_vector[node_negative - 1] += value;
+		if (ops.iter && ops.predictor > 0) {
+			history.push_front(x);
+			if (history.size() > ops.predictor + 1) {
+				history.pop_back();
 			}
 		}
 
-		// Add the voltage sources transient stamp to the source vector
-		int total_voltage_sources = netlist.voltage_sources.size();
-		for (int i = 0; i < total_voltage_sources; i++) {
-			auto &source = netlist.voltage_sources.elements[i];
-			double value = source.eval(time);
-			source_vector[total_nodes - 1 + i] = value;
+		return x;
+	}
+
+	/* Extrapolate the initial guess of the next step from the previous solutions
+	 * with a polynomial through the last (order + 1) equally spaced time points
+	 */
+	void TransientAnalysis::predict_solution(std::deque<Eigen::VectorXd> &history, Eigen::VectorXd &x)
+	{
+		int order = std::min<int>(commands.options.predictor, history.size() - 1);
+
+		switch (order)
+		{
+		case 1:
+			x = 2 * history[0] - history[1];
+			break;
+		case 2:
+			x = 3 * history[0] - 3 * history[1] + history[2];
+			break;
+		default:
+			break;
 		}
 	}
 
@@ -263,6 +1399,12 @@ namespace spic {
 		return "tran_" + step_str + "_" + fin_str + "_V(" + print_node + ").dat";
 	}
 
+	std::string TransientAnalysis::get_iterations_name()
+	{
+		std::string name = get_transient_name("");
+		return name.replace(name.find("_V()"), std::string::npos, "_iterations.dat");
+	}
+
 		/* Routine that prints dc_sweep results */
 	void TransientAnalysis::dump_results(std::unordered_map<std::string, std::vector<double>> transient_data,
 										std::vector<double>                                  transient_times,
@@ -283,6 +1425,22 @@ namespace spic {
 		}
 	}
 
+	/* Routine that prints the iterations of the iterative solver in each time step */
+	void TransientAnalysis::dump_iterations(std::vector<int>        transient_iterations,
+											std::vector<double>     transient_times,
+											std::filesystem::path   transient_dir)
+	{
+		std::ofstream file(transient_dir/get_iterations_name());
+		if (!file.is_open()) {
+			throw std::runtime_error("Unable to open file for writing: "
+										+ (transient_dir/get_iterations_name()).string());
+		}
+		for (int i = 0; i < transient_times.size(); i++) {
+			file << transient_times[i] << " " << transient_iterations[i] << std::endl;
+		}
+		file.close();
+	}
+
 	/* Routine that plots dc_sweep results */
 	void TransientAnalysis::plot_results(std::vector<std::string> &plots,
 										Logger                   &logger,
@@ -8,10 +8,12 @@ void Logger::log(LogLevel level, const std::string& message)
 {
 	// Get current timestamp
 	time_t now = time(0);
-	tm* timeinfo = localtime(&now);
+	// localtime_r, since concurrent Transient Analysises and Parareal workers log through the same Logger
+	tm timeinfo;
+	localtime_r(&now, &timeinfo);
 	char timestamp[20];
 	strftime(timestamp, sizeof(timestamp),
-				"%Y-%m-%d %H:%M:%S", timeinfo);
+				"%Y-%m-%d %H:%M:%S", &timeinfo);
 
 	// Create log entry
 	std::ostringstream logEntry;
@@ -27,10 +29,11 @@ void Logger::log(LogLevel level, std::ostringstream& message)
 {
 	// Get current timestamp
 	time_t now = time(0);
-	tm* timeinfo = localtime(&now);
+	tm timeinfo;
+	localtime_r(&now, &timeinfo);
 	char timestamp[20];
 	strftime(timestamp, sizeof(timestamp),
-				"%Y-%m-%d %H:%M:%S", timeinfo);
+				"%Y-%m-%d %H:%M:%S", &timeinfo);
 
 	std::string line;
 	std::istringstream input(message.str());
@@ -0,0 +1,168 @@
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+#include <Eigen/LU>
+
+#include "whatif.h"
+#include "netlist.h"
+#include "node_table.h"
+
+namespace spic {
+	/* A resistor change adds the stamp of the conductance difference, which is the
+	 * rank-1 term dg * u * u^T where u = e(<+>) - e(<->)
+	 */
+	bool WhatIf::change_resistor(std::string &name, double value)
+	{
+		// The names of spooled resistors are not kept, the what-if variants are skipped in the MPI mode anyway
+		if (netlist.spool) {
+			return value > 0;
+		}
+
+		int id = netlist.resistors.find_element_name(name);
+		if (id == -1 || value <= 0 || is_changed("R" + name)) {
+			return false;
+		}
+
+		Resistor &r = netlist.resistors.elements[id];
+		resistor_changes.push_back({r.node_positive - 1, r.node_negative - 1, 1.0 / value - 1.0 / r.value});
+		descriptions.push_back("R" + name + "=" + std::to_string(value));
+		return true;
+	}
+
+	/* A source change only changes b, with the stamps of the difference of the values */
+	bool WhatIf::change_voltage_source(std::string &name, double value)
+	{
+		int id = netlist.voltage_sources.find_element_name(name);
+		if (id == -1 || is_changed("V" + name)) {
+			return false;
+		}
+
+		int row = node_table.size() - 1 + id;
+		source_changes.push_back({row, value - netlist.voltage_sources.elements[id].value});
+		descriptions.push_back("V" + name + "=" + std::to_string(value));
+		return true;
+	}
+
+	bool WhatIf::change_current_source(std::string &name, double value)
+	{
+		int id = netlist.current_sources.find_element_name(name);
+		if (id == -1 || is_changed("I" + name)) {
+			return false;
+		}
+
+		CurrentSource &i = netlist.current_sources.elements[id];
+		double delta = value - i.value;
+		if (i.node_positive > 0) {
+			source_changes.push_back({i.node_positive - 1, -delta});
+		}
+		if (i.node_negative > 0) {
+			source_changes.push_back({i.node_negative - 1, delta});
+		}
+		descriptions.push_back("I" + name + "=" + std::to_string(value));
+		return true;
+	}
+
+	/* An element is changed at most once in a variant, as the changes are deltas from the netlist
+	 * values and a repeated one would be added on top of the first
+	 */
+	bool WhatIf::is_changed(const std::string &element)
+	{
+		for (auto &description : descriptions) {
+			if (description.compare(0, element.size() + 1, element + "=") == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/* Solve (A + U D U^T) x = b + db with the factorization of A:
+	 *  - [x0 Z] = A^-1 [b + db, U] in one block solve
+	 *  - x = x0 - Z (I + D U^T Z)^-1 D U^T x0
+	 * The k x k system is dense and small, D holds the conductance differences.
+	 */
+	void WhatIf::solve(Solver *solver, const Eigen::VectorXd &b, Eigen::VectorXd &x)
+	{
+		int n = b.size();
+		int k = resistor_changes.size();
+
+		Eigen::MatrixXd B = Eigen::MatrixXd::Zero(n, k + 1);
+		B.col(0) = b;
+		for (auto &change : source_changes) {
+			B(change.first, 0) += change.second;
+		}
+
+		Eigen::VectorXd D(k);
+		for (int j = 0; j < k; j++) {
+			if (resistor_changes[j].node_positive >= 0) {
+				B(resistor_changes[j].node_positive, j + 1) = 1;
+			}
+			if (resistor_changes[j].node_negative >= 0) {
+				B(resistor_changes[j].node_negative, j + 1) = -1;
+			}
+			D(j) = resistor_changes[j].delta_conductance;
+		}
+
+		Eigen::MatrixXd X = Eigen::MatrixXd::Zero(n, k + 1);
+		solver->solve(B, X);
+		x = X.col(0);
+
+		if (k == 0) {
+			return;
+		}
+
+		// U^T y for the columns of U, which have at most two non zeros
+		auto Ut = [&](const Eigen::MatrixXd &Y) {
+			Eigen::MatrixXd R = Eigen::MatrixXd::Zero(k, Y.cols());
+			for (int j = 0; j < k; j++) {
+				if (resistor_changes[j].node_positive >= 0) {
+					R.row(j) += Y.row(resistor_changes[j].node_positive);
+				}
+				if (resistor_changes[j].node_negative >= 0) {
+					R.row(j) -= Y.row(resistor_changes[j].node_negative);
+				}
+			}
+			return R;
+		};
+
+		Eigen::MatrixXd Z = X.rightCols(k);
+		Eigen::MatrixXd M = Eigen::MatrixXd::Identity(k, k) + D.asDiagonal() * Ut(Z);
+		Eigen::VectorXd y = D.asDiagonal() * Ut(X.col(0));
+
+		x -= Z * M.partialPivLu().solve(y);
+	}
+
+	void WhatIf::dump_results(Eigen::VectorXd &x, std::filesystem::path filename)
+	{
+		std::ofstream file(filename);
+		if (!file.is_open()) {
+			throw std::runtime_error("Unable to open file for writing: " + filename.string());
+		}
+
+		file << "Node Voltage" << std::endl;
+		for (auto &it : node_table.table) {
+			if (it.first != "0") {
+				file << it.first << " "
+					 << std::setprecision(std::numeric_limits<double>::max_digits10)
+					 << x[it.second - 1] << std::endl;
+			}
+		}
+		file.close();
+	}
+}
+
+std::ostream& operator<<(std::ostream &out, const spic::WhatIf &whatif) {
+	for (const auto &description : whatif.descriptions) {
+		out << description << " ";
+	}
+	out << std::endl;
+	return out;
+}
+
+std::ostream& operator<<(std::ostream &out, const std::vector<spic::WhatIf> &whatifs) {
+	out << "\tWhat-If Variants:" << std::endl;
+	for (const auto &whatif : whatifs) {
+		out << "\t\t * " << whatif;
+	}
+	return out;
+}